@@ -3,7 +3,10 @@
  *	     of strings.
  *
  * Arrays are sparse doubly-linked lists.  An element's index is stored
- * with it.
+ * with it.  Alongside the list, each array keeps a vector of pointers to
+ * its elements in index order, so that an element can be found by binary
+ * search, or directly when the indices before it have no holes.  The
+ * vector is built the first time it is needed.
  *
  * Chet Ramey
  * chet@ins.cwru.edu
@@ -61,21 +64,189 @@
 		ae->next = new; \
 	} while (0)
 
+static void array_place_elements PARAMS((ARRAY *, int));
+static int array_find_position PARAMS((ARRAY *, arrayind_t));
+static void array_add_element PARAMS((ARRAY *, int, ARRAY_ELEMENT *));
+static void array_remove_element PARAMS((ARRAY *, int));
+
 static char *array_to_string_internal PARAMS((ARRAY_ELEMENT *, ARRAY_ELEMENT *, char *, int));
+static WORD_LIST *array_range_to_word_list PARAMS((ARRAY_ELEMENT *, ARRAY_ELEMENT *));
 
 static char *spacesep = " ";
 
-#define IS_LASTREF(a)	(a->lastref)
+unsigned long array_serial_counter = 0;
+
+/* The smallest number of element pointers allocated for an array */
+#define ELEMENTS_MINSIZE	8
 
-#define LASTREF_START(a, i) \
-	(IS_LASTREF(a) && i >= element_index(a->lastref)) ? a->lastref \
-						          : element_forw(a->head)
+/* The element at position K of A's element vector */
+#define ELEMENT_AT(a, k)	((a)->elements[(a)->elements_start + (k)])
+
+/*
+ * Move the first N element pointers of A into a vector with room for
+ * at least as many again, split between both ends.  If A has no vector
+ * yet, it is built from the element list instead.
+ */
+static void
+array_place_elements (a, n)
+ARRAY	*a;
+int	n;
+{
+	ARRAY_ELEMENT	**v, *ae;
+	int	size, start;
+
+	size = a->elements_size;
+	if (size < (n + 1) * 2)
+		size = (n + 1) * 2;
+	if (size < ELEMENTS_MINSIZE)
+		size = ELEMENTS_MINSIZE;
+	start = (size - n) / 2;
+
+	if (a->elements == 0) {
+		v = (ARRAY_ELEMENT **)xmalloc(size * sizeof(ARRAY_ELEMENT *));
+		for (n = start, ae = element_forw(a->head); ae != a->head; ae = element_forw(ae))
+			v[n++] = ae;
+	} else if (size == a->elements_size) {
+		v = a->elements;
+		memmove(v + start, v + a->elements_start, n * sizeof(ARRAY_ELEMENT *));
+	} else {
+		v = (ARRAY_ELEMENT **)xmalloc(size * sizeof(ARRAY_ELEMENT *));
+		memcpy(v + start, a->elements + a->elements_start, n * sizeof(ARRAY_ELEMENT *));
+		free(a->elements);
+	}
+	a->elements = v;
+	a->elements_start = start;
+	a->elements_size = size;
+}
 
-#define LASTREF(a)	(a->lastref ? a->lastref : element_forw(a->head))
+/*
+ * Return the position in A's element vector of the element with index I,
+ * or of the first element with a greater index if there is no such
+ * element.  Building the vector here means arrays that are only assigned
+ * sequentially and expanded as a whole never need one.
+ */
+static int
+array_find_position (a, i)
+ARRAY	*a;
+arrayind_t	i;
+{
+	register int lo, hi, mid;
+	arrayind_t guess;
 
-#define INVALIDATE_LASTREF(a)	a->lastref = 0
-#define SET_LASTREF(a, e)	a->lastref = (e)
-#define UNSET_LASTREF(a)	a->lastref = 0;
+	if (a->elements == 0)
+		array_place_elements(a, a->num_elements);
+
+	lo = 0;
+	hi = a->num_elements;
+	/*
+	 * Indices increase by at least one per element, so I is no later
+	 * than I - first_index.  Without holes before it, it is right there.
+	 */
+	guess = i - array_first_index(a);
+	if (guess < 0)
+		return 0;
+	if (guess < hi) {
+		if (element_index(ELEMENT_AT(a, guess)) == i)
+			return guess;
+		hi = guess;
+	}
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (element_index(ELEMENT_AT(a, mid)) < i)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * Add AE to A's element vector at position K, moving whichever side of K
+ * is shorter.  Called before AE is counted in A's num_elements.
+ */
+static void
+array_add_element (a, k, ae)
+ARRAY	*a;
+int	k;
+ARRAY_ELEMENT	*ae;
+{
+	int	n, front;
+
+	if (a->elements == 0)
+		return;
+	n = a->num_elements;
+	front = k < n / 2;
+	if (front ? a->elements_start == 0 : a->elements_start + n == a->elements_size)
+		array_place_elements(a, n);
+	if (front) {
+		a->elements_start--;
+		memmove(&ELEMENT_AT(a, 0), &ELEMENT_AT(a, 1), k * sizeof(ARRAY_ELEMENT *));
+	} else
+		memmove(&ELEMENT_AT(a, k + 1), &ELEMENT_AT(a, k), (n - k) * sizeof(ARRAY_ELEMENT *));
+	ELEMENT_AT(a, k) = ae;
+}
+
+/*
+ * Remove the element at position K from A's element vector.  Called
+ * before the element stops being counted in A's num_elements.
+ */
+static void
+array_remove_element (a, k)
+ARRAY	*a;
+int	k;
+{
+	int	n;
+
+	n = a->num_elements;
+	if (k < n / 2) {
+		memmove(&ELEMENT_AT(a, 1), &ELEMENT_AT(a, 0), k * sizeof(ARRAY_ELEMENT *));
+		a->elements_start++;
+	} else
+		memmove(&ELEMENT_AT(a, k), &ELEMENT_AT(a, k + 1), (n - k - 1) * sizeof(ARRAY_ELEMENT *));
+}
+
+/*
+ * Discard A's element vector, for callers that relink A's element list
+ * themselves.  The vector is rebuilt when it is next needed.
+ */
+void
+array_reindex (a)
+ARRAY	*a;
+{
+	FREE(a->elements);
+	a->elements = (ARRAY_ELEMENT **)0;
+	a->elements_start = a->elements_size = 0;
+}
+
+/*
+ * Give A a private copy of the element list it shares with copies made by
+ * array_copy, so that it can be modified without changing them.
+ */
+void
+array_unshare (a)
+ARRAY	*a;
+{
+	ARRAY_ELEMENT	*head, *ae, *new;
+
+	if (a->shared == 0)
+		return;
+	if (--*a->shared == 0) {
+		/* The other sharers have all gone away */
+		free(a->shared);
+		a->shared = (int *)0;
+		return;
+	}
+	a->shared = (int *)0;
+
+	head = array_create_element(-1, (char *)NULL);
+	head->prev = head->next = head;
+	for (ae = element_forw(a->head); ae != a->head; ae = element_forw(ae)) {
+		new = array_create_element(element_index(ae), element_value(ae));
+		ADD_BEFORE(head, new);
+	}
+	a->head = head;
+	array_reindex(a);
+}
 
 ARRAY *
 array_create()
@@ -87,7 +258,10 @@ array_create()
 	r->type = array_indexed;
 	r->max_index = -1;
 	r->num_elements = 0;
-	r->lastref = (ARRAY_ELEMENT *)0;
+	r->elements = (ARRAY_ELEMENT **)0;
+	r->elements_start = r->elements_size = 0;
+	r->shared = (int *)0;
+	array_modified(r);
 	head = array_create_element(-1, (char *)NULL);	/* dummy head */
 	head->prev = head->next = head;
 	r->head = head;
@@ -102,15 +276,25 @@ ARRAY	*a;
 
 	if (a == 0)
 		return;
-	for (r = element_forw(a->head); r != a->head; ) {
-		r1 = element_forw(r);
-		array_dispose_element(r);
-		r = r1;
+	if (a->shared && *a->shared > 1) {
+		/* Leave the elements to the arrays still sharing them */
+		--*a->shared;
+		a->shared = (int *)0;
+		a->head = array_create_element(-1, (char *)NULL);
+	} else {
+		for (r = element_forw(a->head); r != a->head; ) {
+			r1 = element_forw(r);
+			array_dispose_element(r);
+			r = r1;
+		}
+		FREE(a->shared);
+		a->shared = (int *)0;
 	}
 	a->head->next = a->head->prev = a->head;
 	a->max_index = -1;
 	a->num_elements = 0;
-	INVALIDATE_LASTREF(a);
+	array_reindex(a);
+	array_modified(a);
 }
 
 void
@@ -124,25 +308,32 @@ ARRAY	*a;
 	free(a);
 }
 
+/*
+ * Return a copy of A.  The copy shares A's elements until either of them
+ * is modified, so copying is cheap however large A is.
+ */
 ARRAY *
 array_copy(a)
 ARRAY	*a;
 {
 	ARRAY	*a1;
-	ARRAY_ELEMENT	*ae, *new;
 
 	if (a == 0)
 		return((ARRAY *) NULL);
-	a1 = array_create();
+	if (a->shared == 0) {
+		a->shared = (int *)xmalloc(sizeof(int));
+		*a->shared = 1;
+	}
+	a1 = (ARRAY *)xmalloc(sizeof(ARRAY));
 	a1->type = a->type;
 	a1->max_index = a->max_index;
 	a1->num_elements = a->num_elements;
-	for (ae = element_forw(a->head); ae != a->head; ae = element_forw(ae)) {
-		new = array_create_element(element_index(ae), element_value(ae));
-		ADD_BEFORE(a1->head, new);
-		if (ae == LASTREF(a))
-			SET_LASTREF(a1, new);
-	}
+	a1->head = a->head;
+	a1->elements = (ARRAY_ELEMENT **)0;	/* built when needed */
+	a1->elements_start = a1->elements_size = 0;
+	a1->serial = a->serial;
+	a1->shared = a->shared;
+	++*a->shared;
 	return(a1);
 }
 
@@ -211,7 +402,7 @@ int	n, flags;
 	if (a == 0 || array_empty(a) || n <= 0)
 		return ((ARRAY_ELEMENT *)NULL);
 
-	INVALIDATE_LASTREF(a);
+	array_modified(a);
 	for (i = 0, ret = ae = element_forw(a->head); ae != a->head && i < n; ae = element_forw(ae), i++)
 		;
 	if (ae == a->head) {
@@ -226,6 +417,7 @@ int	n, flags;
 		a->head->next = a->head->prev = a->head;
 		a->max_index = -1;
 		a->num_elements = 0;
+		array_reindex(a);
 		return ret;
 	}
 	/*
@@ -236,6 +428,8 @@ int	n, flags;
 
 	a->head->next = ae;		/* slice RET out of the array */
 	ae->prev = a->head;
+	if (a->elements)
+		a->elements_start += n;	/* the order of the rest is unchanged */
 
 	for ( ; ae != a->head; ae = element_forw(ae))
 		element_index(ae) -= n;	/* renumber retained indices */
@@ -273,10 +467,12 @@ char	*s;
 	else if (n <= 0)
 		return (a->num_elements);
 
+	array_modified(a);
 	ae = element_forw(a->head);
 	if (s) {
 		new = array_create_element(0, s);
 		ADD_BEFORE(ae, new);
+		array_add_element(a, 0, new);
 		a->num_elements++;
 		if (array_num_elements(a) == 1)	{	/* array was empty */
 			a->max_index = 0;
@@ -292,7 +488,6 @@ char	*s;
 
 	a->max_index = element_index(a->head->prev);
 
-	INVALIDATE_LASTREF(a);
 	return (a->num_elements);
 }
 
@@ -320,6 +515,7 @@ ARRAY	*array;
 
 	if (array == 0 || array_head(array) == 0 || array_empty(array))
 		return (ARRAY *)NULL;
+	array_modified(array);
 	for (a = element_forw(array->head); a != array->head; a = element_forw(a)) {
 		t = quote_string (a->value);
 		FREE(a->value);
@@ -337,6 +533,7 @@ ARRAY	*array;
 
 	if (array == 0 || array_head(array) == 0 || array_empty(array))
 		return (ARRAY *)NULL;
+	array_modified(array);
 	for (a = element_forw(array->head); a != array->head; a = element_forw(a)) {
 		t = quote_escapes (a->value);
 		FREE(a->value);
@@ -354,6 +551,7 @@ ARRAY	*array;
 
 	if (array == 0 || array_head(array) == 0 || array_empty(array))
 		return (ARRAY *)NULL;
+	array_modified(array);
 	for (a = element_forw(array->head); a != array->head; a = element_forw(a)) {
 		t = dequote_string (a->value);
 		FREE(a->value);
@@ -371,6 +569,7 @@ ARRAY	*array;
 
 	if (array == 0 || array_head(array) == 0 || array_empty(array))
 		return (ARRAY *)NULL;
+	array_modified(array);
 	for (a = element_forw(array->head); a != array->head; a = element_forw(a)) {
 		t = dequote_escapes (a->value);
 		FREE(a->value);
@@ -387,6 +586,7 @@ ARRAY	*array;
 
 	if (array == 0 || array_head(array) == 0 || array_empty(array))
 		return (ARRAY *)NULL;
+	array_modified(array);
 	for (a = element_forw(array->head); a != array->head; a = element_forw(a))
 		a->value = remove_quoted_nulls (a->value);
 	return array;
@@ -403,9 +603,8 @@ ARRAY	*a;
 arrayind_t	start, nelem;
 int	starsub, quoted, pflags;
 {
-	ARRAY		*a2;
 	ARRAY_ELEMENT	*h, *p;
-	arrayind_t	i;
+	int		k;
 	char		*t;
 	WORD_LIST	*wl;
 
@@ -420,20 +619,20 @@ int	starsub, quoted, pflags;
 	 * the end of A (not elements, even with sparse arrays -- START is an
 	 * index).
 	 */
-	for (p = element_forw(p); p != array_head(a) && start > element_index(p); p = element_forw(p))
-		;
-
-	if (p == a->head)
-		return ((char *)NULL);
-
-	/* Starting at P, take NELEM elements, inclusive. */
-	for (i = 0, h = p; p != a->head && i < nelem; i++, p = element_forw(p))
-		;
-
-	a2 = array_slice(a, h, p);
-
-	wl = array_to_word_list(a2);
-	array_dispose(a2);
+	k = array_find_position(a, start);
+	h = ELEMENT_AT(a, k);
+
+	/* Starting at H, take NELEM elements, inclusive. */
+	if (nelem <= 0)
+		p = h;
+	else if (nelem < array_num_elements(a) - k)
+		p = ELEMENT_AT(a, k + nelem);
+	else
+		p = a->head;
+
+	/* Make the words straight from the elements; there is no need to
+	   copy the slice into a new array first. */
+	wl = array_range_to_word_list(h, p);
 	if (wl == 0)
 		return (char *)NULL;
 	t = string_list_pos_params(starsub ? '*' : '@', wl, quoted, pflags);	/* XXX */
@@ -556,83 +755,42 @@ ARRAY	*a;
 arrayind_t	i;
 char	*v;
 {
-	register ARRAY_ELEMENT *new, *ae, *start;
-	arrayind_t startind;
-	int direction;
+	register ARRAY_ELEMENT *new, *ae;
+	int	k;
 
 	if (a == 0)
 		return(-1);
-	new = array_create_element(i, v);
+	array_modified(a);
 	if (i > array_max_index(a)) {
 		/*
 		 * Hook onto the end.  This also works for an empty array.
 		 * Fast path for the common case of allocating arrays
 		 * sequentially.
 		 */
+		new = array_create_element(i, v);
+		array_add_element(a, array_num_elements(a), new);
 		ADD_BEFORE(a->head, new);
 		a->max_index = i;
 		a->num_elements++;
-		SET_LASTREF(a, new);
 		return(0);
-	} else if (i < array_first_index(a)) {
-		/* Hook at the beginning */
-		ADD_AFTER(a->head, new);
-		a->num_elements++;
-		SET_LASTREF(a, new);
-		return(0);
-	}
-#if OPTIMIZE_SEQUENTIAL_ARRAY_ASSIGNMENT
-	/*
-	 * Otherwise we search for the spot to insert it.  The lastref
-	 * handle optimizes the case of sequential or almost-sequential
-	 * assignments that are not at the end of the array.
-	 */
-	start = LASTREF(a);
-	/* Use same strategy as array_reference to avoid paying large penalty
-	   for semi-random assignment pattern. */
-	startind = element_index(start);
-	if (i < startind/2) {
-		start = element_forw(a->head);
-		startind = element_index(start);
-		direction = 1;
-	} else if (i >= startind) {
-		direction = 1;
-	} else {
-		direction = -1;
 	}
-#else
-	start = element_forw(ae->head);
-	startind = element_index(start);
-	direction = 1;
-#endif
-	for (ae = start; ae != a->head; ) {
-		if (element_index(ae) == i) {
-			/*
-			 * Replacing an existing element.
-			 */
-			free(element_value(ae));
-			/* Just swap in the new value */
-			ae->value = new->value;
-			new->value = 0;
-			array_dispose_element(new);
-			SET_LASTREF(a, ae);
-			return(0);
-		} else if (direction == 1 && element_index(ae) > i) {
-			ADD_BEFORE(ae, new);
-			a->num_elements++;
-			SET_LASTREF(a, new);
-			return(0);
-		} else if (direction == -1 && element_index(ae) < i) {
-			ADD_AFTER(ae, new);
-			a->num_elements++;
-			SET_LASTREF(a, new);
-			return(0);
-		}
-		ae = direction == 1 ? element_forw(ae) : element_back(ae);
+	k = array_find_position(a, i);
+	if (k == array_num_elements(a))
+		return (-1);		/* problem */
+	ae = ELEMENT_AT(a, k);
+	if (element_index(ae) == i) {
+		/*
+		 * Replacing an existing element.
+		 */
+		FREE(element_value(ae));
+		ae->value = v ? savestring(v) : (char *)NULL;
+		return(0);
 	}
-	array_dispose_element(new);
-	INVALIDATE_LASTREF(a);
-	return (-1);		/* problem */
+	new = array_create_element(i, v);
+	ADD_BEFORE(ae, new);
+	array_add_element(a, k, new);
+	a->num_elements++;
+	return(0);
 }
 
 /*
@@ -644,53 +802,25 @@ array_remove(a, i)
 ARRAY	*a;
 arrayind_t	i;
 {
-	register ARRAY_ELEMENT *ae, *start;
-	arrayind_t startind;
-	int direction;
+	register ARRAY_ELEMENT *ae;
+	int	k;
 
 	if (a == 0 || array_empty(a))
 		return((ARRAY_ELEMENT *) NULL);
 	if (i > array_max_index(a) || i < array_first_index(a))
-		return((ARRAY_ELEMENT *)NULL);	/* Keep roving pointer into array to optimize sequential access */
-	start = LASTREF(a);
-	/* Use same strategy as array_reference to avoid paying large penalty
-	   for semi-random assignment pattern. */
-	startind = element_index(start);
-	if (i < startind/2) {
-		start = element_forw(a->head);
-		startind = element_index(start);
-		direction = 1;
-	} else if (i >= startind) {
-		direction = 1;
-	} else {
-		direction = -1;
-	}
-	for (ae = start; ae != a->head; ) {
-		if (element_index(ae) == i) {
-			ae->next->prev = ae->prev;
-			ae->prev->next = ae->next;
-			a->num_elements--;
-			if (i == array_max_index(a))
-				a->max_index = element_index(ae->prev);
-#if 0
-			INVALIDATE_LASTREF(a);
-#else
-			if (ae->next != a->head)
-				SET_LASTREF(a, ae->next);
-			else if (ae->prev != a->head)
-				SET_LASTREF(a, ae->prev);
-			else
-				INVALIDATE_LASTREF(a);
-#endif
-			return(ae);
-		}
-		ae = (direction == 1) ? element_forw(ae) : element_back(ae);
-		if (direction == 1 && element_index(ae) > i)
-			break;
-		else if (direction == -1 && element_index(ae) < i)
-			break;
-	}
-	return((ARRAY_ELEMENT *) NULL);
+		return((ARRAY_ELEMENT *)NULL);
+	array_modified(a);
+	k = array_find_position(a, i);
+	ae = ELEMENT_AT(a, k);
+	if (element_index(ae) != i)
+		return((ARRAY_ELEMENT *) NULL);
+	array_remove_element(a, k);
+	ae->next->prev = ae->prev;
+	ae->prev->next = ae->next;
+	a->num_elements--;
+	if (i == array_max_index(a))
+		a->max_index = element_index(ae->prev);
+	return(ae);
 }
 
 /*
@@ -701,55 +831,41 @@ array_reference(a, i)
 ARRAY	*a;
 arrayind_t	i;
 {
-	register ARRAY_ELEMENT *ae, *start;
-	arrayind_t startind;
-	int direction;
+	register ARRAY_ELEMENT *ae;
+	int	k;
 
 	if (a == 0 || array_empty(a))
 		return((char *) NULL);
 	if (i > array_max_index(a) || i < array_first_index(a))
-		return((char *)NULL);	/* Keep roving pointer into array to optimize sequential access */
-	start = LASTREF(a);	/* lastref pointer */
-	startind = element_index(start);
-	if (i < startind/2) {	/* XXX - guess */
-		start = element_forw(a->head);
-		startind = element_index(start);
-		direction = 1;
-	} else if (i >= startind) {
-		direction = 1;
-	} else {
-		direction = -1;
-	}
-	for (ae = start; ae != a->head; ) {
-		if (element_index(ae) == i) {
-			SET_LASTREF(a, ae);
-			return(element_value(ae));
-		}
-		ae = (direction == 1) ? element_forw(ae) : element_back(ae);
-		/* Take advantage of index ordering to short-circuit */
-		/* If we don't find it, set the lastref pointer to the element
-		   that's `closest', assuming that the unsuccessful reference
-		   will quickly be followed by an assignment.  No worse than
-		   not changing it from the previous value or resetting it. */
-		if (direction == 1 && element_index(ae) > i) {
-			start = ae;	/* use for SET_LASTREF below */
-			break;
-		} else if (direction == -1 && element_index(ae) < i) {
-			start = ae;	/* use for SET_LASTREF below */
-			break;
-		}
-	}
-#if 0
-	UNSET_LASTREF(a);
-#else
-	SET_LASTREF(a, start);
-#endif
-	return((char *) NULL);
+		return((char *)NULL);
+	k = array_find_position(a, i);
+	ae = ELEMENT_AT(a, k);
+	return(element_index(ae) == i ? element_value(ae) : (char *) NULL);
 }
 
 /* Convenience routines for the shell to translate to and from the form used
    by the rest of the code. */
 
+/*
+ * Return a list of the values of the elements from START up to, but not
+ * including, END.  The list is built back to front so it comes out in
+ * order without being reversed.
+ */
+static WORD_LIST *
+array_range_to_word_list(start, end)
+ARRAY_ELEMENT	*start, *end;
+{
+	WORD_LIST	*list;
+	ARRAY_ELEMENT	*ae;
+
+	if (start == end)
+		return((WORD_LIST *)NULL);
+	list = (WORD_LIST *)NULL;
+	for (ae = element_back(end); ae != element_back(start); ae = element_back(ae))
+		list = make_word_list (make_bare_word(element_value(ae)), list);
+	return (list);
+}
+
 WORD_LIST *
 array_to_word_list(a)
 ARRAY	*a;
@@ -759,10 +875,7 @@ ARRAY	*a;
 
 	if (a == 0 || array_empty(a))
 		return((WORD_LIST *)NULL);
-	list = (WORD_LIST *)NULL;
-	for (ae = element_forw(a->head); ae != a->head; ae = element_forw(ae))
-		list = make_word_list (make_bare_word(element_value(ae)), list);
-	return (REVERSE_LIST(list, WORD_LIST *));
+	return (array_range_to_word_list(element_forw(a->head), a->head));
 }
 
 ARRAY *
@@ -34,7 +34,11 @@ typedef struct array {
 	arrayind_t	max_index;
 	int		num_elements;
 	struct array_element *head;
-	struct array_element *lastref;
+	struct array_element **elements;	/* the elements in index order */
+	int		elements_start;	/* offset of the first element pointer */
+	int		elements_size;	/* number of pointers allocated */
+	unsigned long	serial;		/* changed by every modification */
+	int	*shared;		/* how many arrays share the elements */
 } ARRAY;
 
 typedef struct array_element {
@@ -45,6 +49,8 @@ typedef struct array_element {
 
 typedef int sh_ae_map_func_t PARAMS((ARRAY_ELEMENT *, void *));
 
+extern unsigned long array_serial_counter;
+
 /* Basic operations on entire arrays */
 extern ARRAY	*array_create PARAMS((void));
 extern void	array_flush PARAMS((ARRAY *));
@@ -52,6 +58,8 @@ extern void	array_dispose PARAMS((ARRAY *));
 extern ARRAY	*array_copy PARAMS((ARRAY *));
 extern ARRAY	*array_slice PARAMS((ARRAY *, ARRAY_ELEMENT *, ARRAY_ELEMENT *));
 extern void	array_walk PARAMS((ARRAY   *, sh_ae_map_func_t *, void *));
+extern void	array_reindex PARAMS((ARRAY *));
+extern void	array_unshare PARAMS((ARRAY *));
 
 extern ARRAY_ELEMENT *array_shift PARAMS((ARRAY *, int, int));
 extern int	array_rshift PARAMS((ARRAY *, int, char *));
@@ -99,6 +107,12 @@ extern ARRAY *array_from_string PARAMS((char *, char *));
 #define array_first_index(a)	((a)->head->next->ind)
 #define array_head(a)		((a)->head)
 #define array_empty(a)		((a)->num_elements == 0)
+#define array_serial(a)		((a)->serial)
+
+/* Call before modifying A.  This gives A its own copy of any elements it
+   shares with copies of it, and a new serial number, so that values cached
+   from its elements can tell they are stale. */
+#define array_modified(a)	(array_unshare(a), (a)->serial = ++array_serial_counter)
 
 #define element_value(ae)	((ae)->value)
 #define element_index(ae)	((ae)->ind)
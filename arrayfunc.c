@@ -55,7 +55,7 @@ int array_expand_once = 0;
 static SHELL_VAR *bind_array_var_internal PARAMS((SHELL_VAR *, arrayind_t, char *, char *, int));
 static SHELL_VAR *assign_array_element_internal PARAMS((SHELL_VAR *, char *, char *, char *, int, char *, int));
 
-static void assign_assoc_from_kvlist PARAMS((SHELL_VAR *, WORD_LIST *, HASH_TABLE *, int));
+static void assign_assoc_from_kvlist PARAMS((SHELL_VAR *, WORD_LIST *, ASSOC *, int));
 
 static char *quote_assign PARAMS((const char *));
 static void quote_array_assignment_chars PARAMS((WORD_LIST *));
@@ -116,7 +116,7 @@ convert_var_to_assoc (var)
      SHELL_VAR *var;
 {
   char *oldval;
-  HASH_TABLE *hash;
+  ASSOC *hash;
 
   oldval = value_cell (var);
   hash = assoc_create (0);
@@ -197,7 +197,7 @@ make_array_variable_value (entry, ind, key, value, flags)
 static SHELL_VAR *
 bind_assoc_var_internal (entry, hash, key, value, flags)
      SHELL_VAR *entry;
-     HASH_TABLE *hash;
+     ASSOC *hash;
      char *key;
      char *value;
      int flags;
@@ -559,7 +559,7 @@ static void
 assign_assoc_from_kvlist (var, nlist, h, flags)
      SHELL_VAR *var;
      WORD_LIST *nlist;
-     HASH_TABLE *h;
+     ASSOC *h;
      int flags;
 {
   WORD_LIST *list;
@@ -614,7 +614,7 @@ assign_compound_array_list (var, nlist, flags)
      int flags;
 {
   ARRAY *a;
-  HASH_TABLE *h, *nhash;
+  ASSOC *h, *nhash;
   WORD_LIST *list;
   char *w, *val, *nval, *savecmd;
   int len, iflags, free_val;
@@ -622,7 +622,7 @@ assign_compound_array_list (var, nlist, flags)
   char *akey;
 
   a = (var && array_p (var)) ? array_cell (var) : (ARRAY *)0;
-  nhash = h = (var && assoc_p (var)) ? assoc_cell (var) : (HASH_TABLE *)0;
+  nhash = h = (var && assoc_p (var)) ? assoc_cell (var) : (ASSOC *)0;
 
   akey = (char *)0;
   ind = 0;
@@ -634,7 +634,7 @@ assign_compound_array_list (var, nlist, flags)
       if (a && array_p (var))
 	array_flush (a);
       else if (h && assoc_p (var))
-	nhash = assoc_create (h->nbuckets);
+	nhash = assoc_create (assoc_num_elements (h));
     }
 
   last_ind = (a && (flags & ASS_APPEND)) ? array_max_index (a) + 1 : 0;
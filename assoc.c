@@ -1,7 +1,8 @@
 /*
  * assoc.c - functions to manipulate associative arrays
  *
- * Associative arrays are standard shell hash tables.
+ * Associative arrays keep their entries in the order they were added,
+ * with an open-addressed index from keys to entries.
  *
  * Chet Ramey
  * chet@ins.cwru.edu
@@ -44,121 +45,395 @@
 #include "assoc.h"
 #include "builtins/common.h"
 
-static WORD_LIST *assoc_to_word_list_internal PARAMS((HASH_TABLE *, int));
+static WORD_LIST *assoc_to_word_list_internal PARAMS((ASSOC *, int));
 
-/* assoc_create == hash_create */
+/* Index sizes are powers of two, kept at most three quarters full */
+#define ASSOC_INDEX_MIN		16
+#define ASSOC_INDEX_FULL(h, n)	((n) * 4 > (h)->nindex * 3)
+
+#define INDEX_HOME(h, hv)	((hv) & ((h)->nindex - 1))
+
+static int assoc_find PARAMS((ASSOC *, const char *, unsigned int, int *));
+static void assoc_reindex PARAMS((ASSOC *, int));
+static void assoc_unindex PARAMS((ASSOC *, int));
+static ASSOC_ENTRY *assoc_add PARAMS((ASSOC *, char *, unsigned int));
+static void assoc_set_value PARAMS((ASSOC_ENTRY *, char *));
+static void assoc_unshare PARAMS((ASSOC *));
+
+/* Make a new associative array with room for N entries without growing.
+   Nothing is allocated until the first entry is added. */
+ASSOC *
+assoc_create (n)
+     int n;
+{
+  ASSOC *h;
+
+  h = (ASSOC *)xmalloc (sizeof (ASSOC));
+  h->entries = (ASSOC_ENTRY *)NULL;
+  h->nentries = h->nused = 0;
+  h->nalloc = (n > 0) ? n : ASSOC_HASH_BUCKETS;
+  h->index = (int *)NULL;
+  h->nindex = 0;
+  h->shared = (int *)NULL;
+  return h;
+}
+
+/* Return the position in H's entries of the entry with KEY, which hashes
+   to HV, or -1.  If SLOTP is non-null, it gets the index slot holding the
+   entry's position, or the empty slot where it would go. */
+static int
+assoc_find (h, key, hv, slotp)
+     ASSOC *h;
+     const char *key;
+     unsigned int hv;
+     int *slotp;
+{
+  register int i, p;
+
+  if (h->index == 0)
+    return -1;
+  for (i = INDEX_HOME (h, hv); (p = h->index[i]) >= 0; i = (i + 1) & (h->nindex - 1))
+    if (h->entries[p].khash == hv && STREQ (h->entries[p].key, key))
+      break;
+  if (slotp)
+    *slotp = i;
+  return p;
+}
+
+/* Rebuild H's index with NSIZE slots, first squeezing the holes left by
+   removed entries out of H's entries. */
+static void
+assoc_reindex (h, nsize)
+     ASSOC *h;
+     int nsize;
+{
+  register int i, j;
+
+  for (i = j = 0; i < h->nused; i++)
+    if (h->entries[i].key)
+      h->entries[j++] = h->entries[i];
+  h->nused = j;
+
+  if (nsize != h->nindex)
+    {
+      FREE (h->index);
+      h->index = (int *)xmalloc (nsize * sizeof (int));
+      h->nindex = nsize;
+    }
+  for (i = 0; i < nsize; i++)
+    h->index[i] = -1;
+  for (i = 0; i < h->nused; i++)
+    {
+      for (j = INDEX_HOME (h, h->entries[i].khash); h->index[j] >= 0; j = (j + 1) & (nsize - 1))
+	;
+      h->index[j] = i;
+    }
+}
+
+/* Empty index slot I of H, moving later entries of the same probe run back
+   into it when they would otherwise no longer be found. */
+static void
+assoc_unindex (h, i)
+     ASSOC *h;
+     int i;
+{
+  register int j, home, mask;
+
+  mask = h->nindex - 1;
+  for (j = i; ; )
+    {
+      h->index[i] = -1;
+      for (;;)
+	{
+	  j = (j + 1) & mask;
+	  if (h->index[j] < 0)
+	    return;
+	  home = INDEX_HOME (h, h->entries[h->index[j]].khash);
+	  /* The entry at J can stay unless I lies between HOME and J */
+	  if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+	    continue;
+	  break;
+	}
+      h->index[i] = h->index[j];
+      i = j;
+    }
+}
+
+/* Add a new entry for KEY, which hashes to HV and is not in H, with no
+   value.  KEY is reused for the entry's storage. */
+static ASSOC_ENTRY *
+assoc_add (h, key, hv)
+     ASSOC *h;
+     char *key;
+     unsigned int hv;
+{
+  ASSOC_ENTRY *e;
+  int i, nsize;
+
+  if (h->entries == 0)
+    h->entries = (ASSOC_ENTRY *)xmalloc (h->nalloc * sizeof (ASSOC_ENTRY));
+  else if (h->nused == h->nalloc)
+    {
+      /* Squeeze out holes if that frees at least half the entries */
+      if (h->nentries <= h->nused / 2)
+	assoc_reindex (h, h->nindex);
+      else
+	{
+	  h->nalloc *= 2;
+	  h->entries = (ASSOC_ENTRY *)xrealloc (h->entries, h->nalloc * sizeof (ASSOC_ENTRY));
+	}
+    }
+
+  if (h->index == 0 || ASSOC_INDEX_FULL (h, h->nentries + 1))
+    {
+      for (nsize = h->nindex ? h->nindex * 2 : ASSOC_INDEX_MIN; ASSOC_INDEX_FULL (h, h->nalloc) && nsize < h->nalloc * 2; nsize *= 2)
+	;
+      assoc_reindex (h, nsize);
+    }
+
+  for (i = INDEX_HOME (h, hv); h->index[i] >= 0; i = (i + 1) & (h->nindex - 1))
+    ;
+  h->index[i] = h->nused;
+
+  e = &h->entries[h->nused++];
+  e->key = key;
+  e->value = (char *)NULL;
+  e->khash = hv;
+  e->vsize = 0;
+  h->nentries++;
+  return e;
+}
+
+/* Set the value of entry E to a copy of VALUE, growing the allocation it
+   shares with E's key if the value does not fit. */
+static void
+assoc_set_value (e, value)
+     ASSOC_ENTRY *e;
+     char *value;
+{
+  int klen, vlen;
+
+  if (value == 0)
+    {
+      e->value = (char *)NULL;
+      return;
+    }
+  klen = strlen (e->key) + 1;
+  vlen = strlen (value) + 1;
+  if (vlen > e->vsize)
+    {
+      e->key = (char *)xrealloc (e->key, klen + vlen);
+      e->vsize = vlen;
+    }
+  e->value = e->key + klen;
+  memmove (e->value, value, vlen);
+}
 
 void
 assoc_dispose (hash)
-     HASH_TABLE *hash;
+     ASSOC *hash;
 {
   if (hash)
     {
-      hash_flush (hash, 0);
-      hash_dispose (hash);
+      assoc_flush (hash);
+      free (hash);
     }
 }
 
 void
 assoc_flush (hash)
-     HASH_TABLE *hash;
+     ASSOC *hash;
 {
-  hash_flush (hash, 0);
+  int i;
+
+  if (hash->shared && *hash->shared > 1)
+    --*hash->shared;		/* the other sharers keep the entries */
+  else
+    {
+      for (i = 0; i < hash->nused; i++)
+	FREE (hash->entries[i].key);
+      FREE (hash->entries);
+      FREE (hash->index);
+      FREE (hash->shared);
+    }
+  hash->shared = (int *)NULL;
+  hash->entries = (ASSOC_ENTRY *)NULL;
+  hash->index = (int *)NULL;
+  hash->nentries = hash->nused = hash->nindex = 0;
+}
+
+/* Give H its own copy of the entries and index it shares with copies made
+   by assoc_copy, so that it can be modified without changing them. */
+static void
+assoc_unshare (h)
+     ASSOC *h;
+{
+  ASSOC_ENTRY *entries;
+  int *index, i, size;
+
+  if (h->shared == 0)
+    return;
+  if (--*h->shared == 0)
+    {
+      /* The other sharers have all gone away */
+      free (h->shared);
+      h->shared = (int *)NULL;
+      return;
+    }
+  h->shared = (int *)NULL;
+
+  if (h->entries == 0)
+    return;
+  entries = (ASSOC_ENTRY *)xmalloc (h->nalloc * sizeof (ASSOC_ENTRY));
+  for (i = 0; i < h->nused; i++)
+    {
+      entries[i] = h->entries[i];
+      if (h->entries[i].key == 0)
+	continue;
+      /* The key and the room for its value are one allocation */
+      size = strlen (h->entries[i].key) + 1 + h->entries[i].vsize;
+      entries[i].key = (char *)xmalloc (size);
+      memcpy (entries[i].key, h->entries[i].key, size);
+      if (h->entries[i].value)
+	entries[i].value = entries[i].key + (h->entries[i].value - h->entries[i].key);
+    }
+  h->entries = entries;
+
+  index = (int *)xmalloc (h->nindex * sizeof (int));
+  memcpy (index, h->index, h->nindex * sizeof (int));
+  h->index = index;
+}
+
+/* Return a copy of HASH.  The copy shares HASH's entries until either of
+   them is modified, so copying is cheap however large HASH is. */
+ASSOC *
+assoc_copy (hash)
+     ASSOC *hash;
+{
+  ASSOC *new;
+
+  if (hash == 0)
+    return ((ASSOC *)NULL);
+
+  if (hash->shared == 0)
+    {
+      hash->shared = (int *)xmalloc (sizeof (int));
+      *hash->shared = 1;
+    }
+  new = (ASSOC *)xmalloc (sizeof (ASSOC));
+  *new = *hash;
+  ++*hash->shared;
+  return new;
 }
 
 int
 assoc_insert (hash, key, value)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      char *key;
      char *value;
 {
-  BUCKET_CONTENTS *b;
+  ASSOC_ENTRY *e;
+  unsigned int hv;
+  int p;
 
-  b = hash_search (key, hash, HASH_CREATE);
-  if (b == 0)
-    return -1;
-  /* If we are overwriting an existing element's value, we're not going to
-     use the key.  Nothing in the array assignment code path frees the key
-     string, so we can free it here to avoid a memory leak. */
-  if (b->key != key)
-    free (key);
-  FREE (b->data);
-  b->data = value ? savestring (value) : (char *)0;
+  assoc_unshare (hash);
+  hv = hash_string (key);
+  if ((p = assoc_find (hash, key, hv, (int *)NULL)) >= 0)
+    {
+      /* If we are overwriting an existing element's value, we're not going
+	 to use the key.  Nothing in the array assignment code path frees the
+	 key string, so we can free it here to avoid a memory leak. */
+      free (key);
+      e = &hash->entries[p];
+    }
+  else
+    e = assoc_add (hash, key, hv);
+  assoc_set_value (e, value);
   return (0);
 }
 
-/* Like assoc_insert, but returns b->data instead of freeing it */
+/* Like assoc_insert, but returns the old value instead of freeing it */
 PTR_T
 assoc_replace (hash, key, value)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      char *key;
      char *value;
 {
-  BUCKET_CONTENTS *b;
+  ASSOC_ENTRY *e;
+  unsigned int hv;
   PTR_T t;
+  int p;
 
-  b = hash_search (key, hash, HASH_CREATE);
-  if (b == 0)
-    return (PTR_T)0;
-  /* If we are overwriting an existing element's value, we're not going to
-     use the key.  Nothing in the array assignment code path frees the key
-     string, so we can free it here to avoid a memory leak. */
-  if (b->key != key)
-    free (key);
-  t = b->data;
-  b->data = value ? savestring (value) : (char *)0;
+  t = (PTR_T)0;
+  assoc_unshare (hash);
+  hv = hash_string (key);
+  if ((p = assoc_find (hash, key, hv, (int *)NULL)) >= 0)
+    {
+      free (key);
+      e = &hash->entries[p];
+      if (e->value)
+	t = savestring (e->value);
+    }
+  else
+    e = assoc_add (hash, key, hv);
+  assoc_set_value (e, value);
   return t;
 }
 
 void
 assoc_remove (hash, string)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      char *string;
 {
-  BUCKET_CONTENTS *b;
-
-  b = hash_remove (string, hash, 0);
-  if (b)
-    {
-      free ((char *)b->data);
-      free (b->key);
-      free (b);
-    }
+  int p, slot;
+
+  assoc_unshare (hash);
+  if ((p = assoc_find (hash, string, hash_string (string), &slot)) < 0)
+    return;
+
+  assoc_unindex (hash, slot);
+  free (hash->entries[p].key);
+  hash->entries[p].key = (char *)NULL;
+  hash->nentries--;
+  /* Holes at the end of the entries can be reused right away */
+  while (hash->nused > 0 && hash->entries[hash->nused - 1].key == 0)
+    hash->nused--;
 }
 
 char *
 assoc_reference (hash, string)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      char *string;
 {
-  BUCKET_CONTENTS *b;
+  int p;
 
   if (hash == 0)
     return (char *)0;
 
-  b = hash_search (string, hash, 0);
-  return (b ? (char *)b->data : 0);
+  p = assoc_find (hash, string, hash_string (string), (int *)NULL);
+  return (p >= 0 ? hash->entries[p].value : 0);
 }
 
 /* Quote the data associated with each element of the hash table ASSOC,
    using quote_string */
-HASH_TABLE *
+ASSOC *
 assoc_quote (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   int i;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   char *t;
 
   if (h == 0 || assoc_empty (h))
-    return ((HASH_TABLE *)NULL);
+    return ((ASSOC *)NULL);
   
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  assoc_unshare (h);
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	t = quote_string ((char *)tlist->data);
-	FREE (tlist->data);
-	tlist->data = t;
+	t = quote_string (tlist->value);
+	assoc_set_value (tlist, t);
+	FREE (t);
       }
 
   return h;
@@ -166,88 +441,92 @@ assoc_quote (h)
 
 /* Quote escape characters in the data associated with each element
    of the hash table ASSOC, using quote_escapes */
-HASH_TABLE *
+ASSOC *
 assoc_quote_escapes (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   int i;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   char *t;
 
   if (h == 0 || assoc_empty (h))
-    return ((HASH_TABLE *)NULL);
+    return ((ASSOC *)NULL);
   
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  assoc_unshare (h);
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	t = quote_escapes ((char *)tlist->data);
-	FREE (tlist->data);
-	tlist->data = t;
+	t = quote_escapes (tlist->value);
+	assoc_set_value (tlist, t);
+	FREE (t);
       }
 
   return h;
 }
 
-HASH_TABLE *
+ASSOC *
 assoc_dequote (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   int i;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   char *t;
 
   if (h == 0 || assoc_empty (h))
-    return ((HASH_TABLE *)NULL);
+    return ((ASSOC *)NULL);
   
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  assoc_unshare (h);
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	t = dequote_string ((char *)tlist->data);
-	FREE (tlist->data);
-	tlist->data = t;
+	t = dequote_string (tlist->value);
+	assoc_set_value (tlist, t);
+	FREE (t);
       }
 
   return h;
 }
 
-HASH_TABLE *
+ASSOC *
 assoc_dequote_escapes (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   int i;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   char *t;
 
   if (h == 0 || assoc_empty (h))
-    return ((HASH_TABLE *)NULL);
+    return ((ASSOC *)NULL);
   
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  assoc_unshare (h);
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	t = dequote_escapes ((char *)tlist->data);
-	FREE (tlist->data);
-	tlist->data = t;
+	t = dequote_escapes (tlist->value);
+	assoc_set_value (tlist, t);
+	FREE (t);
       }
 
   return h;
 }
 
-HASH_TABLE *
+ASSOC *
 assoc_remove_quoted_nulls (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   int i;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   char *t;
 
   if (h == 0 || assoc_empty (h))
-    return ((HASH_TABLE *)NULL);
+    return ((ASSOC *)NULL);
   
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  assoc_unshare (h);
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	t = remove_quoted_nulls ((char *)tlist->data);
-	tlist->data = t;
+	t = remove_quoted_nulls (tlist->value);	/* in place */
+	tlist->value = t;
       }
 
   return h;
@@ -259,49 +538,48 @@ assoc_remove_quoted_nulls (h)
  */
 char *
 assoc_subrange (hash, start, nelem, starsub, quoted, pflags)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      arrayind_t start, nelem;
      int starsub, quoted, pflags;
 {
-  WORD_LIST *l, *save, *h, *t;
+  WORD_LIST *list;
+  ASSOC_ENTRY *e;
   int i, j;
   char *ret;
 
   if (assoc_empty (hash))
     return ((char *)NULL);
 
-  save = l = assoc_to_word_list (hash);
-  if (save == 0)
+  /* Walk the entries to the first one wanted and make words for just the
+     range, rather than converting the whole array to a list first. */
+  for (i = j = 0; i < assoc_size (hash) && j < start - 1; i++)
+    if (assoc_entry (hash, i))
+      j++;
+  for ( ; i < assoc_size (hash) && assoc_entry (hash, i) == 0; i++)
+    ;
+  if (i >= assoc_size (hash))
     return ((char *)NULL);
 
-  for (i = 1; l && i < start; i++)
-    l = l->next;
-  if (l == 0)
-    {
-      dispose_words (save);
-      return ((char *)NULL);
-    }
-  for (j = 0,h = t = l; l && j < nelem; j++)
-    {
-      t = l;
-      l = l->next;
-    }
-
-  t->next = (WORD_LIST *)NULL;
-
-  ret = string_list_pos_params (starsub ? '*' : '@', h, quoted, pflags);
+  if (nelem <= 0)
+    nelem = 1;
+  list = (WORD_LIST *)NULL;
+  for (j = 0; i < assoc_size (hash) && j < nelem; i++)
+    if (e = assoc_entry (hash, i))
+      {
+	list = make_word_list (make_bare_word (e->value), list);
+	j++;
+      }
+  list = REVERSE_LIST (list, WORD_LIST *);
 
-  if (t != l)
-    t->next = l;
+  ret = string_list_pos_params (starsub ? '*' : '@', list, quoted, pflags);
 
-  dispose_words (save);
+  dispose_words (list);
   return (ret);
-
 }
 
 char *
 assoc_patsub (h, pat, rep, mflags)
-     HASH_TABLE *h;
+     ASSOC *h;
      char *pat, *rep;
      int mflags;
 {
@@ -335,7 +613,7 @@ assoc_patsub (h, pat, rep, mflags)
 
 char *
 assoc_modcase (h, pat, modop, mflags)
-     HASH_TABLE *h;
+     ASSOC *h;
      char *pat;
      int modop;
      int mflags;
@@ -370,13 +648,13 @@ assoc_modcase (h, pat, modop, mflags)
 
 char *
 assoc_to_kvpair (hash, quoted)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      int quoted;
 {
   char *ret;
   char *istr, *vstr;
   int i, rsize, rlen, elen;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
 
   if (hash == 0 || assoc_empty (hash))
     return (char *)0;
@@ -384,8 +662,8 @@ assoc_to_kvpair (hash, quoted)
   ret = xmalloc (rsize = 128);
   ret[rlen = 0] = '\0';
 
-  for (i = 0; i < hash->nbuckets; i++)
-    for (tlist = hash_items (i, hash); tlist; tlist = tlist->next)
+  for (i = 0; i < assoc_size (hash); i++)
+    if (tlist = assoc_entry (hash, i))
       {
 	if (ansic_shouldquote (tlist->key))
 	  istr = ansic_quote (tlist->key, 0, (int *)0);
@@ -396,9 +674,9 @@ assoc_to_kvpair (hash, quoted)
 	else
 	  istr = tlist->key;	
 
-	vstr = tlist->data ? (ansic_shouldquote ((char *)tlist->data) ?
-				ansic_quote ((char *)tlist->data, 0, (int *)0) :
-				sh_double_quote ((char *)tlist->data))
+	vstr = tlist->value ? (ansic_shouldquote (tlist->value) ?
+				ansic_quote (tlist->value, 0, (int *)0) :
+				sh_double_quote (tlist->value))
 			   : (char *)0;
 
 	elen = STRLEN (istr) + 4 + STRLEN (vstr);
@@ -440,13 +718,13 @@ assoc_to_kvpair (hash, quoted)
 
 char *
 assoc_to_assign (hash, quoted)
-     HASH_TABLE *hash;
+     ASSOC *hash;
      int quoted;
 {
   char *ret;
   char *istr, *vstr;
   int i, rsize, rlen, elen;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
 
   if (hash == 0 || assoc_empty (hash))
     return (char *)0;
@@ -455,8 +733,8 @@ assoc_to_assign (hash, quoted)
   ret[0] = '(';
   rlen = 1;
 
-  for (i = 0; i < hash->nbuckets; i++)
-    for (tlist = hash_items (i, hash); tlist; tlist = tlist->next)
+  for (i = 0; i < assoc_size (hash); i++)
+    if (tlist = assoc_entry (hash, i))
       {
 	if (ansic_shouldquote (tlist->key))
 	  istr = ansic_quote (tlist->key, 0, (int *)0);
@@ -467,9 +745,9 @@ assoc_to_assign (hash, quoted)
 	else
 	  istr = tlist->key;	
 
-	vstr = tlist->data ? (ansic_shouldquote ((char *)tlist->data) ?
-				ansic_quote ((char *)tlist->data, 0, (int *)0) :
-				sh_double_quote ((char *)tlist->data))
+	vstr = tlist->value ? (ansic_shouldquote (tlist->value) ?
+				ansic_quote (tlist->value, 0, (int *)0) :
+				sh_double_quote (tlist->value))
 			   : (char *)0;
 
 	elen = STRLEN (istr) + 8 + STRLEN (vstr);
@@ -509,22 +787,22 @@ assoc_to_assign (hash, quoted)
 
 static WORD_LIST *
 assoc_to_word_list_internal (h, t)
-     HASH_TABLE *h;
+     ASSOC *h;
      int t;
 {
   WORD_LIST *list;
   int i;
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   char *w;
 
   if (h == 0 || assoc_empty (h))
     return((WORD_LIST *)NULL);
   list = (WORD_LIST *)NULL;
   
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	w = (t == 0) ? (char *)tlist->data : (char *)tlist->key;
+	w = (t == 0) ? tlist->value : tlist->key;
 	list = make_word_list (make_bare_word(w), list);
       }
   return (REVERSE_LIST(list, WORD_LIST *));
@@ -532,25 +810,25 @@ assoc_to_word_list_internal (h, t)
 
 WORD_LIST *
 assoc_to_word_list (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   return (assoc_to_word_list_internal (h, 0));
 }
 
 WORD_LIST *
 assoc_keys_to_word_list (h)
-     HASH_TABLE *h;
+     ASSOC *h;
 {
   return (assoc_to_word_list_internal (h, 1));
 }
 
 char *
 assoc_to_string (h, sep, quoted)
-     HASH_TABLE *h;
+     ASSOC *h;
      char *sep;
      int quoted;
 {
-  BUCKET_CONTENTS *tlist;
+  ASSOC_ENTRY *tlist;
   int i;
   char *result, *t, *w;
   WORD_LIST *list, *l;
@@ -565,10 +843,10 @@ assoc_to_string (h, sep, quoted)
   /* This might be better implemented directly, but it's simple to implement
      by converting to a word list first, possibly quoting the data, then
      using list_string */
-  for (i = 0; i < h->nbuckets; i++)
-    for (tlist = hash_items (i, h); tlist; tlist = tlist->next)
+  for (i = 0; i < assoc_size (h); i++)
+    if (tlist = assoc_entry (h, i))
       {
-	w = (char *)tlist->data;
+	w = tlist->value;
 	if (w == 0)
 	  continue;
 	t = quoted ? quote_string (w) : savestring (w);
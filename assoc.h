@@ -25,41 +25,68 @@
 #include "stdc.h"
 #include "hashlib.h"
 
-#define ASSOC_HASH_BUCKETS	1024
+/* The number of entries a new associative array has room for */
+#define ASSOC_HASH_BUCKETS	8
+
+/* An associative array keeps its entries in one vector, in the order their
+   keys were first assigned, and finds them through an open-addressed index
+   of positions in that vector.  An entry's key and value share a single
+   allocation, KEY\0VALUE\0.  Removing an entry leaves a hole in the vector
+   until enough holes build up to squeeze them out. */
+typedef struct assoc_entry {
+  char *key;			/* NULL if the entry has been removed */
+  char *value;			/* Points after the key, or is NULL */
+  unsigned int khash;		/* What key hashes to */
+  int vsize;			/* Room for the value after the key */
+} ASSOC_ENTRY;
+
+typedef struct assoc {
+  ASSOC_ENTRY *entries;		/* In the order they were added */
+  int nentries;			/* How many entries there are */
+  int nused;			/* How many of ENTRIES are used, with holes */
+  int nalloc;			/* How many ENTRIES are allocated */
+  int *index;			/* Positions in ENTRIES, -1 if unused */
+  int nindex;			/* Size of INDEX, a power of two */
+  int *shared;			/* How many arrays share ENTRIES and INDEX */
+} ASSOC;
 
 #define assoc_empty(h)		((h)->nentries == 0)
 #define assoc_num_elements(h)	((h)->nentries)
 
-#define assoc_create(n)		(hash_create((n)))
+/* Walk the entries in order with
+	for (i = 0; i < assoc_size (h); i++)
+	  if (e = assoc_entry (h, i)) ...	*/
+#define assoc_size(h)		((h)->nused)
+#define assoc_entry(h, i)	((h)->entries[i].key ? &(h)->entries[i] \
+						     : (ASSOC_ENTRY *)NULL)
 
-#define assoc_copy(h)		(hash_copy((h), 0))
+extern ASSOC *assoc_create PARAMS((int));
+extern ASSOC *assoc_copy PARAMS((ASSOC *));
 
-#define assoc_walk(h, f)	(hash_walk((h), (f))
+extern void assoc_dispose PARAMS((ASSOC *));
+extern void assoc_flush PARAMS((ASSOC *));
 
-extern void assoc_dispose PARAMS((HASH_TABLE *));
-extern void assoc_flush PARAMS((HASH_TABLE *));
+extern int assoc_insert PARAMS((ASSOC *, char *, char *));
+extern PTR_T assoc_replace PARAMS((ASSOC *, char *, char *));
+extern void assoc_remove PARAMS((ASSOC *, char *));
 
-extern int assoc_insert PARAMS((HASH_TABLE *, char *, char *));
-extern PTR_T assoc_replace PARAMS((HASH_TABLE *, char *, char *));
-extern void assoc_remove PARAMS((HASH_TABLE *, char *));
+extern char *assoc_reference PARAMS((ASSOC *, char *));
 
-extern char *assoc_reference PARAMS((HASH_TABLE *, char *));
+extern char *assoc_subrange PARAMS((ASSOC *, arrayind_t, arrayind_t, int, int, int));
+extern char *assoc_patsub PARAMS((ASSOC *, char *, char *, int));
+extern char *assoc_modcase PARAMS((ASSOC *, char *, int, int));
 
-extern char *assoc_subrange PARAMS((HASH_TABLE *, arrayind_t, arrayind_t, int, int, int));
-extern char *assoc_patsub PARAMS((HASH_TABLE *, char *, char *, int));
-extern char *assoc_modcase PARAMS((HASH_TABLE *, char *, int, int));
+extern ASSOC *assoc_quote PARAMS((ASSOC *));
+extern ASSOC *assoc_quote_escapes PARAMS((ASSOC *));
+extern ASSOC *assoc_dequote PARAMS((ASSOC *));
+extern ASSOC *assoc_dequote_escapes PARAMS((ASSOC *));
+extern ASSOC *assoc_remove_quoted_nulls PARAMS((ASSOC *));
 
-extern HASH_TABLE *assoc_quote PARAMS((HASH_TABLE *));
-extern HASH_TABLE *assoc_quote_escapes PARAMS((HASH_TABLE *));
-extern HASH_TABLE *assoc_dequote PARAMS((HASH_TABLE *));
-extern HASH_TABLE *assoc_dequote_escapes PARAMS((HASH_TABLE *));
-extern HASH_TABLE *assoc_remove_quoted_nulls PARAMS((HASH_TABLE *));
+extern char *assoc_to_kvpair PARAMS((ASSOC *, int));
+extern char *assoc_to_assign PARAMS((ASSOC *, int));
 
-extern char *assoc_to_kvpair PARAMS((HASH_TABLE *, int));
-extern char *assoc_to_assign PARAMS((HASH_TABLE *, int));
+extern WORD_LIST *assoc_to_word_list PARAMS((ASSOC *));
+extern WORD_LIST *assoc_keys_to_word_list PARAMS((ASSOC *));
 
-extern WORD_LIST *assoc_to_word_list PARAMS((HASH_TABLE *));
-extern WORD_LIST *assoc_keys_to_word_list PARAMS((HASH_TABLE *));
-
-extern char *assoc_to_string PARAMS((HASH_TABLE *, char *, int));
+extern char *assoc_to_string PARAMS((ASSOC *, char *, int));
 #endif /* _ASSOC_H_ */
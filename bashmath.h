@@ -0,0 +1,43 @@
+#ifndef BASHMATH_H
+#define BASHMATH_H
+
+/*
+ * The public interface to libbashmath. Only the functions declared here are
+ * exported from libbashmath.so; the rest of the engine (math_parser.h) is
+ * internal to the library.
+ */
+
+#include <stdio.h>
+
+#if defined(__GNUC__) && __GNUC__ >= 4
+    #define BM_API __attribute__((visibility("default")))
+#else
+    #define BM_API
+#endif
+
+/*
+ * One BashMath engine with its own identifiers, watched formulas and output
+ * format. Contexts are independent of one another, so separate contexts may
+ * be used at once on separate threads, but a context must only be used by
+ * one thread at a time.
+ */
+typedef struct BmContext BmContext;
+
+/* The value of an expression, a scalar or a vector of len elements */
+typedef struct {
+    int is_vector;
+    long long val;      /* A scalar's value */
+    long long* elems;   /* A vector's elements, freed with bm_value_free() */
+    long long len;      /* The number of elements in a vector */
+} BmValue;
+
+/* Returns a new context, or NULL if it could not be allocated */
+BM_API BmContext*  bm_context_new(void);
+BM_API void        bm_context_free(BmContext*);
+/* Sets where a context prints results and errors, stdout and stderr at first */
+BM_API int         bm_set_streams(BmContext*, FILE*, FILE*);
+BM_API int         bm_evaluate(BmContext*, const char*, BmValue*);
+BM_API int         bm_print(BmContext*, const BmValue*);
+BM_API void        bm_value_free(BmValue*);
+
+#endif
@@ -146,11 +146,6 @@
    want it on. */
 #define CHECKWINSIZE_DEFAULT	1
 
-/* Define to 1 if you want to optimize for sequential array assignment when
-   using indexed arrays, 0 if you want bash-4.2 behavior, which favors
-   random access but is O(N) for each array assignment. */
-#define OPTIMIZE_SEQUENTIAL_ARRAY_ASSIGNMENT	1
-
 /* Define to 1 if you want to be able to export indexed arrays to processes
    using the foo=([0]=one [1]=two) and so on */
 /* #define ARRAY_EXPORT 1 */
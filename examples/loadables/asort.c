@@ -56,8 +56,8 @@ compare(const void *p1, const void *p2) {
 
 static int
 sort_index(SHELL_VAR *dest, SHELL_VAR *source) {
-    HASH_TABLE *hash;
-    BUCKET_CONTENTS *bucket;
+    ASSOC *hash;
+    ASSOC_ENTRY *entry;
     sort_element *sa;
     ARRAY *array, *dest_array;
     ARRAY_ELEMENT *ae;
@@ -72,18 +72,17 @@ sort_index(SHELL_VAR *dest, SHELL_VAR *source) {
         n = hash->nentries;
         sa = xmalloc(n * sizeof(sort_element));
         i = 0;
-        for ( j = 0; j < hash->nbuckets; ++j ) {
-            bucket = hash->bucket_array[j];
-            while ( bucket ) {
-                sa[i].v = NULL;
-                sa[i].key = bucket->key;
-                if ( numeric_flag )
-                    sa[i].num = strtod(bucket->data, NULL);
-                else
-                    sa[i].value = bucket->data;
-                i++;
-                bucket = bucket->next;
-            }
+        for ( j = 0; j < assoc_size(hash); ++j ) {
+            entry = assoc_entry(hash, j);
+            if ( entry == NULL )
+                continue;
+            sa[i].v = NULL;
+            sa[i].key = entry->key;
+            if ( numeric_flag )
+                sa[i].num = strtod(entry->value, NULL);
+            else
+                sa[i].value = entry->value;
+            i++;
         }
     }
     else {
@@ -139,6 +138,9 @@ sort_inplace(SHELL_VAR *var) {
 
     sa = xmalloc(n * sizeof(sort_element));
 
+    // the elements are relinked in place, so A can't share them
+    array_modified(a);
+
     i = 0;
     for (ae = element_forw(a->head); ae != a->head; ae = element_forw(ae)) {
         sa[i].v = ae;
@@ -162,6 +164,7 @@ sort_inplace(SHELL_VAR *var) {
     a->head->next = sa[0].v;
     a->head->prev = sa[n-1].v;
     a->max_index = n - 1;
+    array_reindex(a);
     for (i = 0; i < n; i++) {
         sa[i].v->ind = i;
         if (i > 0)
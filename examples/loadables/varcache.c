@@ -0,0 +1,60 @@
+/* varcache - print the hit rate of the shell's variable lookup cache */
+
+/*
+   Copyright (C) 2020 Free Software Foundation, Inc.
+
+   This file is part of GNU Bash.
+   Bash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Bash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Bash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#if defined (HAVE_UNISTD_H)
+#  include <unistd.h>
+#endif
+
+#include <stdio.h>
+
+#include "builtins.h"
+#include "shell.h"
+#include "common.h"
+
+int
+varcache_builtin (list)
+     WORD_LIST *list;
+{
+  if (no_options (list))
+    return (EX_USAGE);
+
+  var_cache_pstats ();
+  return (EXECUTION_SUCCESS);
+}
+
+char *varcache_doc[] = {
+	"Display variable lookup cache statistics.",
+	"",
+	"Write the number of variable lookups answered from the shell's",
+	"lookup cache, the number that had to search every variable scope,",
+	"and the cache's current generation to the standard error.",
+	(char *)NULL
+};
+
+struct builtin varcache_struct = {
+	"varcache",
+	varcache_builtin,
+	BUILTIN_ENABLED,
+	varcache_doc,
+	"varcache",
+	0
+};
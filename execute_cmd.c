@@ -3476,7 +3476,7 @@ execute_case_command (case_command)
   register WORD_LIST *list;
   WORD_LIST *wlist, *es;
   PATTERN_LIST *clauses;
-  char *word, *pattern;
+  char *word, *pattern, *lit;
   int retval, match, ignore_return, save_line_number, qflags;
 
   save_line_number = line_number;
@@ -3562,7 +3562,14 @@ execute_case_command (case_command)
 	  /* Since the pattern does not undergo quote removal (as per
 	     Posix.2, section 3.9.4.3), the strmatch () call must be able
 	     to recognize backslashes as escape characters. */
-	  match = strmatch (pattern, word, FNMATCH_EXTFLAG|FNMATCH_IGNCASE) != FNM_NOMATCH;
+	  /* A pattern without pattern characters only has to be compared */
+	  if (match_ignore_case == 0 && (lit = literal_glob_pattern (pattern)))
+	    {
+	      match = STREQ (lit, word);
+	      free (lit);
+	    }
+	  else
+	    match = strmatch_cached (pattern, word, FNMATCH_EXTFLAG|FNMATCH_IGNCASE) != FNM_NOMATCH;
 	  free (pattern);
 
 	  dispose_words (es);
@@ -325,6 +325,7 @@ extern int sh_eaccess PARAMS((const char *, int));
 
 /* declarations for functions defined in lib/sh/shmatch.c */
 extern int sh_regmatch PARAMS((const char *, const char *, int));
+extern void sh_regflush PARAMS((void));
 
 /* defines for flags argument to sh_regmatch. */
 #define SHMAT_SUBEXP		0x001	/* save subexpressions in SH_REMATCH */
@@ -505,6 +506,7 @@ extern char *utf8_mbsmbchar PARAMS((const char *));
 extern int utf8_mbsnlen PARAMS((const char *, size_t, int));
 extern int utf8_mblen PARAMS((const char *, size_t));
 extern size_t utf8_mbstrlen PARAMS((const char *));
+extern char *utf8_mbsadvance PARAMS((const char *, const char *, size_t, size_t *));
 
 /* declarations for functions defined in lib/sh/wcsnwidth.c */
 #if defined (HANDLE_MULTIBYTE)
@@ -36,26 +36,55 @@
 
 /* tunable constants for rehashing */
 #define HASH_REHASH_MULTIPLIER	4
-#define HASH_REHASH_FACTOR	2
 
+/* The table is open-addressed, so it must grow before it fills up.  Grow
+   once three quarters of the slots are in use. */
 #define HASH_SHOULDGROW(table) \
-  ((table)->nentries >= (table)->nbuckets * HASH_REHASH_FACTOR)
+  ((table)->nentries >= (table)->nbuckets - (table)->nbuckets / 4)
 
 /* an initial approximation */
 #define HASH_SHOULDSHRINK(table) \
   (((table)->nbuckets > DEFAULT_HASH_BUCKETS) && \
    ((table)->nentries < (table)->nbuckets / HASH_REHASH_MULTIPLIER))
 
+/* The number of items moved out of the old slot array by each insertion
+   or removal while the table is being rehashed.  With the table growing
+   by HASH_REHASH_MULTIPLIER, the move is done long before the table next
+   needs to grow. */
+#define HASH_REHASH_STEP	4
+
 /* Rely on properties of unsigned division (unsigned/int -> unsigned) and
    don't discard the upper 32 bits of the value, if present. */
 #define HASH_BUCKET(s, t, h) (((h) = hash_string (s)) & ((t)->nbuckets - 1))
 
-static BUCKET_CONTENTS *copy_bucket_array PARAMS((BUCKET_CONTENTS *, sh_string_func_t *));
+/* How far the item hashing to H that sits in slot I of an array of N slots
+   is from the slot it hashes to. */
+#define PROBE_DISTANCE(h, i, n)	(((i) - (h)) & ((n) - 1))
+
+static int slot_find PARAMS((BUCKET_CONTENTS **, unsigned int *, int, const char *, unsigned int));
+static void slot_place PARAMS((BUCKET_CONTENTS **, unsigned int *, int, BUCKET_CONTENTS *, int));
+static void slot_delete PARAMS((BUCKET_CONTENTS **, unsigned int *, int, int));
 
 static void hash_rehash PARAMS((HASH_TABLE *, int));
+static void hash_rehash_step PARAMS((HASH_TABLE *, int));
 static void hash_grow PARAMS((HASH_TABLE *));
 static void hash_shrink PARAMS((HASH_TABLE *));
 
+/* Each table is an array of NBUCKETS slots, each holding at most one
+   item, with collisions resolved by linear probing.  Items are placed
+   Robin Hood style: an item being placed takes the slot of any item
+   closer to the slot it hashes to, so probe sequences stay short and a
+   search can stop as soon as it passes the point where the key would
+   have been placed.  Removing an item shifts the items after it back a
+   slot, so no deleted markers are left behind.  Each slot's hash is kept
+   in a parallel array so probing touches the items themselves only when
+   the hashes match.
+
+   Growing the table does not move every item at once.  The old slot
+   array is kept alongside the new one, and each later insertion or
+   removal moves a few items across.  Searches look in both arrays until
+   the old one is empty. */
+
 /* Make a new hash table with BUCKETS number of buckets.  Initialize
    each slot in the table to NULL. */
 HASH_TABLE *
@@ -71,9 +100,15 @@ hash_create (buckets)
 
   new_table->bucket_array =
     (BUCKET_CONTENTS **)xmalloc (buckets * sizeof (BUCKET_CONTENTS *));
+  new_table->bucket_hashes =
+    (unsigned int *)xmalloc (buckets * sizeof (unsigned int));
   new_table->nbuckets = buckets;
   new_table->nentries = 0;
 
+  new_table->old_array = (BUCKET_CONTENTS **)NULL;
+  new_table->old_hashes = (unsigned int *)NULL;
+  new_table->old_nbuckets = new_table->old_nentries = new_table->old_next = 0;
+
   for (i = 0; i < buckets; i++)
     new_table->bucket_array[i] = (BUCKET_CONTENTS *)NULL;
 
@@ -87,71 +122,161 @@ hash_size (table)
   return (HASH_ENTRIES(table));
 }
 
-static BUCKET_CONTENTS *
-copy_bucket_array (ba, cpdata)
-     BUCKET_CONTENTS *ba;
-     sh_string_func_t *cpdata;	/* data copy function */
+/* Return the slot of ARRAY, an array of N slots with hashes HASHES, that
+   holds the item with key STRING, which hashes to HV, or -1. */
+static int
+slot_find (array, hashes, n, string, hv)
+     BUCKET_CONTENTS **array;
+     unsigned int *hashes;
+     int n;
+     const char *string;
+     unsigned int hv;
 {
-  BUCKET_CONTENTS *new_bucket, *n, *e;
-
-  if (ba == 0)
-    return ((BUCKET_CONTENTS *)0);
+  register int i, dist;
 
-  for (n = (BUCKET_CONTENTS *)0, e = ba; e; e = e->next)
+  for (i = hv & (n - 1), dist = 0; array[i]; i = (i + 1) & (n - 1), dist++)
     {
-      if (n == 0)
-        {
-          new_bucket = (BUCKET_CONTENTS *)xmalloc (sizeof (BUCKET_CONTENTS));
-          n = new_bucket;
-        }
-      else
-        {
-          n->next = (BUCKET_CONTENTS *)xmalloc (sizeof (BUCKET_CONTENTS));
-          n = n->next;
-        }
+      /* Robin Hood placement would have put STRING before this item */
+      if (PROBE_DISTANCE (hashes[i], i, n) < dist)
+	break;
+      if (hashes[i] == hv && STREQ (array[i]->key, string))
+	return i;
+    }
+  return -1;
+}
 
-      n->key = savestring (e->key);
-      n->data = e->data ? (cpdata ? (*cpdata) (e->data) : savestring (e->data))
-			: NULL;
-      n->khash = e->khash;
-      n->times_found = e->times_found;
-      n->next = (BUCKET_CONTENTS *)NULL;
+/* Place ITEM in ARRAY, an array of N slots with hashes HASHES that has at
+   least one free slot.  Callers inserting with HASH_NOSRCH may add a key
+   that is already present; searches must find the newest such item, so
+   items with the same key are kept newest first.  If NEWEST is non-zero,
+   ITEM is newer than any item with the same key, otherwise it is older. */
+static void
+slot_place (array, hashes, n, item, newest)
+     BUCKET_CONTENTS **array;
+     unsigned int *hashes;
+     int n;
+     BUCKET_CONTENTS *item;
+     int newest;
+{
+  register int i, dist, rdist;
+  BUCKET_CONTENTS *t;
+  unsigned int hv, th;
+
+  hv = item->khash;
+  for (i = hv & (n - 1), dist = 0; array[i]; i = (i + 1) & (n - 1), dist++)
+    {
+      rdist = PROBE_DISTANCE (hashes[i], i, n);
+      if (rdist < dist || (rdist == dist && newest && hashes[i] == hv && STREQ (array[i]->key, item->key)))
+	{
+	  /* Take this slot and carry on placing the item that was in it,
+	     which is newer than any item with its key further along */
+	  t = array[i]; array[i] = item; item = t;
+	  th = hashes[i]; hashes[i] = hv; hv = th;
+	  dist = rdist;
+	  newest = 1;
+	}
     }
+  array[i] = item;
+  hashes[i] = hv;
+}
+
+/* Empty slot I of ARRAY, an array of N slots with hashes HASHES, shifting
+   the items displaced past it back a slot to close the gap. */
+static void
+slot_delete (array, hashes, n, i)
+     BUCKET_CONTENTS **array;
+     unsigned int *hashes;
+     int n, i;
+{
+  register int j;
 
-  return new_bucket;  
+  for (j = (i + 1) & (n - 1); array[j] && PROBE_DISTANCE (hashes[j], j, n) > 0; j = (j + 1) & (n - 1))
+    {
+      array[i] = array[j];
+      hashes[i] = hashes[j];
+      i = j;
+    }
+  array[i] = (BUCKET_CONTENTS *)NULL;
 }
 
+/* Start moving the items of TABLE into a new slot array of NSIZE slots.
+   The items are moved a few at a time by hash_rehash_step. */
 static void
 hash_rehash (table, nsize)
      HASH_TABLE *table;
      int nsize;
 {
-  int osize, i, j;
-  BUCKET_CONTENTS **old_bucket_array, *item, *next;
+  int i;
 
   if (table == NULL || nsize == table->nbuckets)
     return;
 
-  osize = table->nbuckets;
-  old_bucket_array = table->bucket_array;
+  /* Finish any move already under way */
+  hash_rehash_step (table, table->old_nentries);
+
+  table->old_array = table->bucket_array;
+  table->old_hashes = table->bucket_hashes;
+  table->old_nbuckets = table->nbuckets;
+  table->old_nentries = table->nentries;
+  table->old_next = 0;
 
   table->nbuckets = nsize;
   table->bucket_array = (BUCKET_CONTENTS **)xmalloc (table->nbuckets * sizeof (BUCKET_CONTENTS *));
+  table->bucket_hashes = (unsigned int *)xmalloc (table->nbuckets * sizeof (unsigned int));
   for (i = 0; i < table->nbuckets; i++)
     table->bucket_array[i] = (BUCKET_CONTENTS *)NULL;
 
-  for (j = 0; j < osize; j++)
+  if (table->old_nentries == 0)
+    hash_rehash_step (table, 0);
+}
+
+/* Move up to COUNT items from TABLE's old slot array into the current one,
+   freeing the old array once it is empty.  The old array is emptied from
+   the front; each slot is emptied before moving on, since removing an item
+   can shift the next one back into its slot. */
+static void
+hash_rehash_step (table, count)
+     HASH_TABLE *table;
+     int count;
+{
+  BUCKET_CONTENTS *item;
+
+  if (table->old_array == 0)
+    return;
+
+  while (count > 0 && table->old_nentries > 0)
     {
-      for (item = old_bucket_array[j]; item; item = next)
+      item = table->old_array[table->old_next];
+      if (item == 0)
 	{
-	  next = item->next;
-	  i = item->khash & (table->nbuckets - 1);
-	  item->next = table->bucket_array[i];
-	  table->bucket_array[i] = item;
+	  table->old_next++;
+	  continue;
 	}
+      slot_delete (table->old_array, table->old_hashes, table->old_nbuckets, table->old_next);
+      table->old_nentries--;
+      /* Items with the same key leave the old array newest first */
+      slot_place (table->bucket_array, table->bucket_hashes, table->nbuckets, item, 0);
+      count--;
     }
 
-  free (old_bucket_array);
+  if (table->old_nentries == 0)
+    {
+      free (table->old_array);
+      free (table->old_hashes);
+      table->old_array = (BUCKET_CONTENTS **)NULL;
+      table->old_hashes = (unsigned int *)NULL;
+      table->old_nbuckets = table->old_next = 0;
+    }
+}
+
+/* Finish moving TABLE's items into its current slot array, so that the
+   slots can be walked with hash_items.  Always returns 0. */
+int
+hash_rehash_finish (table)
+     HASH_TABLE *table;
+{
+  hash_rehash_step (table, table->old_nentries);
+  return 0;
 }
 
 static void
@@ -181,20 +306,96 @@ hash_copy (table, cpdata)
      sh_string_func_t *cpdata;
 {
   HASH_TABLE *new_table;
+  BUCKET_CONTENTS *e, *n;
   int i;
 
   if (table == 0)
     return ((HASH_TABLE *)NULL);
 
+  hash_rehash_finish (table);
   new_table = hash_create (table->nbuckets);
 
+  /* Same size, so every item can go in the same slot */
   for (i = 0; i < table->nbuckets; i++)
-    new_table->bucket_array[i] = copy_bucket_array (table->bucket_array[i], cpdata);
+    {
+      if ((e = table->bucket_array[i]) == 0)
+	continue;
+      n = (BUCKET_CONTENTS *)xmalloc (sizeof (BUCKET_CONTENTS));
+      n->key = savestring (e->key);
+      n->data = e->data ? (cpdata ? (*cpdata) (e->data) : savestring (e->data))
+			: NULL;
+      n->khash = e->khash;
+      n->times_found = e->times_found;
+      n->next = (BUCKET_CONTENTS *)NULL;
+      new_table->bucket_array[i] = n;
+      new_table->bucket_hashes[i] = table->bucket_hashes[i];
+    }
 
   new_table->nentries = table->nentries;
   return new_table;
 }
 
+#if defined (HAVE_UNSIGNED_LONG_LONG)
+/* Strings are hashed a 64-bit word at a time, in the style of wyhash: each
+   word is mixed in with a multiply whose high and low halves are folded
+   together.  Words are read with memcpy, so S need not be aligned and
+   nothing past its terminating NUL is read. */
+
+typedef unsigned long long hash_word_t;
+
+#define HASH_SEED	0xa0761d6478bd642fULL
+#define HASH_MUL1	0xe7037ed1a0b428dbULL
+#define HASH_MUL2	0x8ebc6af09c88c6e3ULL
+
+static inline hash_word_t
+hash_mix (a, b)
+     hash_word_t a, b;
+{
+#if defined (__SIZEOF_INT128__)
+  unsigned __int128 r;
+
+  r = (unsigned __int128)a * b;
+  return ((hash_word_t)(r >> 64) ^ (hash_word_t)r);
+#else
+  hash_word_t r;
+
+  r = a * b;
+  return (r ^ (r >> 29) ^ (a >> 32) * (b >> 32));
+#endif
+}
+
+/* The `khash' check below requires that strings that compare equally with
+   strcmp hash to the same value. */
+unsigned int
+hash_string (s)
+     const char *s;
+{
+  size_t len, n;
+  hash_word_t h, w;
+
+  len = strlen (s);
+  h = HASH_SEED ^ (len * HASH_MUL1);
+
+  for (n = len; n >= sizeof (w); n -= sizeof (w), s += sizeof (w))
+    {
+      memcpy (&w, s, sizeof (w));
+      h = hash_mix (h ^ w, HASH_MUL1);
+    }
+
+  /* The last partial word, zero-padded; LEN above tells "a" from "a\0" */
+  if (n)
+    {
+      w = 0;
+      memcpy (&w, s, n);
+      h = hash_mix (h ^ w, HASH_MUL1);
+    }
+
+  h = hash_mix (h, HASH_MUL2);
+  return ((unsigned int)(h ^ (h >> 32)));
+}
+
+#else /* !HAVE_UNSIGNED_LONG_LONG */
+
 /* This is the best 32-bit string hash function I found. It's one of the
    Fowler-Noll-Vo family (FNV-1).
 
@@ -204,11 +405,6 @@ hash_copy (table, cpdata)
 #define FNV_OFFSET 2166136261
 #define FNV_PRIME 16777619
 
-/* If you want to use 64 bits, use
-FNV_OFFSET	14695981039346656037
-FNV_PRIME	1099511628211
-*/
-
 /* The `khash' check below requires that strings that compare equally with
    strcmp hash to the same value. */
 unsigned int
@@ -228,6 +424,7 @@ hash_string (s)
 
   return i;
 }
+#endif /* !HAVE_UNSIGNED_LONG_LONG */
 
 /* Return the location of the bucket which should contain the data
    for STRING.  TABLE is a pointer to a HASH_TABLE. */
@@ -242,6 +439,31 @@ hash_bucket (string, table)
   return (HASH_BUCKET (string, table, h));
 }
 
+/* Add a new item for STRING, which hashes to HV, to TABLE. */
+static BUCKET_CONTENTS *
+hash_add (string, table, hv)
+     char *string;
+     HASH_TABLE *table;
+     unsigned int hv;
+{
+  BUCKET_CONTENTS *item;
+
+  hash_rehash_step (table, HASH_REHASH_STEP);
+  if (HASH_SHOULDGROW (table))
+    hash_grow (table);
+
+  item = (BUCKET_CONTENTS *)xmalloc (sizeof (BUCKET_CONTENTS));
+  item->next = (BUCKET_CONTENTS *)NULL;
+  item->data = NULL;
+  item->key = string;
+  item->khash = hv;
+  item->times_found = 0;
+
+  slot_place (table->bucket_array, table->bucket_hashes, table->nbuckets, item, 1);
+  table->nentries++;
+  return (item);
+}
+
 /* Return a pointer to the hashed item.  If the HASH_CREATE flag is passed,
    create a new hash table entry for STRING, otherwise return NULL. */
 BUCKET_CONTENTS *
@@ -249,46 +471,43 @@ hash_search (string, table, flags)
      const char *string;
      HASH_TABLE *table;
      int flags;
+{
+  if (table == 0 || ((flags & HASH_CREATE) == 0 && HASH_ENTRIES (table) == 0))
+    return (BUCKET_CONTENTS *)NULL;
+
+  return (hash_search_hashed (string, hash_string (string), table, flags));
+}
+
+/* Like hash_search, but HV is STRING's hash, as returned by hash_string.
+   Callers searching several tables for the same key hash it once. */
+BUCKET_CONTENTS *
+hash_search_hashed (string, hv, table, flags)
+     const char *string;
+     unsigned int hv;
+     HASH_TABLE *table;
+     int flags;
 {
   BUCKET_CONTENTS *list;
-  int bucket;
-  unsigned int hv;
+  int i;
 
   if (table == 0 || ((flags & HASH_CREATE) == 0 && HASH_ENTRIES (table) == 0))
     return (BUCKET_CONTENTS *)NULL;
 
-  bucket = HASH_BUCKET (string, table, hv);
+  list = (BUCKET_CONTENTS *)NULL;
+  if ((i = slot_find (table->bucket_array, table->bucket_hashes, table->nbuckets, string, hv)) >= 0)
+    list = table->bucket_array[i];
+  else if (table->old_array &&
+	   (i = slot_find (table->old_array, table->old_hashes, table->old_nbuckets, string, hv)) >= 0)
+    list = table->old_array[i];
 
-  for (list = table->bucket_array ? table->bucket_array[bucket] : 0; list; list = list->next)
+  if (list)
     {
-      /* This is the comparison function */
-      if (hv == list->khash && STREQ (list->key, string))
-	{
-	  list->times_found++;
-	  return (list);
-	}
+      list->times_found++;
+      return (list);
     }
 
   if (flags & HASH_CREATE)
-    {
-      if (HASH_SHOULDGROW (table))
-	{
-	  hash_grow (table);
-	  bucket = HASH_BUCKET (string, table, hv);
-	}
-
-      list = (BUCKET_CONTENTS *)xmalloc (sizeof (BUCKET_CONTENTS));
-      list->next = table->bucket_array[bucket];
-      table->bucket_array[bucket] = list;
-
-      list->data = NULL;
-      list->key = (char *)string;	/* XXX fix later */
-      list->khash = hv;
-      list->times_found = 0;
-
-      table->nentries++;
-      return (list);
-    }
+    return (hash_add ((char *)string, table, hv));	/* XXX fix later */
       
   return (BUCKET_CONTENTS *)NULL;
 }
@@ -302,30 +521,32 @@ hash_remove (string, table, flags)
      HASH_TABLE *table;
      int flags;
 {
-  int bucket;
-  BUCKET_CONTENTS *prev, *temp;
+  BUCKET_CONTENTS *temp;
+  int i;
   unsigned int hv;
 
   if (table == 0 || HASH_ENTRIES (table) == 0)
     return (BUCKET_CONTENTS *)NULL;
 
-  bucket = HASH_BUCKET (string, table, hv);
-  prev = (BUCKET_CONTENTS *)NULL;
-  for (temp = table->bucket_array[bucket]; temp; temp = temp->next)
+  hv = hash_string (string);
+  if ((i = slot_find (table->bucket_array, table->bucket_hashes, table->nbuckets, string, hv)) >= 0)
     {
-      if (hv == temp->khash && STREQ (temp->key, string))
-	{
-	  if (prev)
-	    prev->next = temp->next;
-	  else
-	    table->bucket_array[bucket] = temp->next;
-
-	  table->nentries--;
-	  return (temp);
-	}
-      prev = temp;
+      temp = table->bucket_array[i];
+      slot_delete (table->bucket_array, table->bucket_hashes, table->nbuckets, i);
     }
-  return ((BUCKET_CONTENTS *) NULL);
+  else if (table->old_array &&
+	   (i = slot_find (table->old_array, table->old_hashes, table->old_nbuckets, string, hv)) >= 0)
+    {
+      temp = table->old_array[i];
+      slot_delete (table->old_array, table->old_hashes, table->old_nbuckets, i);
+      table->old_nentries--;
+    }
+  else
+    return ((BUCKET_CONTENTS *) NULL);
+
+  table->nentries--;
+  hash_rehash_step (table, HASH_REHASH_STEP);
+  return (temp);
 }
 
 /* Create an entry for STRING, in TABLE.  If the entry already
@@ -337,8 +558,6 @@ hash_insert (string, table, flags)
      int flags;
 {
   BUCKET_CONTENTS *item;
-  int bucket;
-  unsigned int hv;
 
   if (table == 0)
     table = hash_create (0);
@@ -347,23 +566,7 @@ hash_insert (string, table, flags)
   			       : hash_search (string, table, 0);
 
   if (item == 0)
-    {
-      if (HASH_SHOULDGROW (table))
-	hash_grow (table);
-
-      bucket = HASH_BUCKET (string, table, hv);
-
-      item = (BUCKET_CONTENTS *)xmalloc (sizeof (BUCKET_CONTENTS));
-      item->next = table->bucket_array[bucket];
-      table->bucket_array[bucket] = item;
-
-      item->data = NULL;
-      item->key = string;
-      item->khash = hv;
-      item->times_found = 0;
-
-      table->nentries++;
-    }
+    item = hash_add (string, table, hash_string (string));
 
   return (item);
 }
@@ -377,27 +580,24 @@ hash_flush (table, free_data)
      sh_free_func_t *free_data;
 {
   int i;
-  register BUCKET_CONTENTS *bucket, *item;
+  register BUCKET_CONTENTS *item;
 
   if (table == 0 || HASH_ENTRIES (table) == 0)
     return;
 
+  hash_rehash_finish (table);
   for (i = 0; i < table->nbuckets; i++)
     {
-      bucket = table->bucket_array[i];
+      item = table->bucket_array[i];
+      if (item == 0)
+	continue;
 
-      while (bucket)
-	{
-	  item = bucket;
-	  bucket = bucket->next;
-
-	  if (free_data)
-	    (*free_data) (item->data);
-	  else
-	    free (item->data);
-	  free (item->key);
-	  free (item);
-	}
+      if (free_data)
+	(*free_data) (item->data);
+      else
+	free (item->data);
+      free (item->key);
+      free (item);
       table->bucket_array[i] = (BUCKET_CONTENTS *)NULL;
     }
 
@@ -409,7 +609,10 @@ void
 hash_dispose (table)
      HASH_TABLE *table;
 {
+  FREE (table->old_array);
+  FREE (table->old_hashes);
   free (table->bucket_array);
+  free (table->bucket_hashes);
   free (table);
 }
 
@@ -438,7 +641,7 @@ hash_pstats (table, name)
      HASH_TABLE *table;
      char *name;
 {
-  register int slot, bcount;
+  register int slot;
   register BUCKET_CONTENTS *bc;
 
   if (name == 0)
@@ -446,17 +649,17 @@ hash_pstats (table, name)
 
   fprintf (stderr, "%s: %d buckets; %d items\n", name, table->nbuckets, table->nentries);
 
-  /* Print out a count of how many strings hashed to each bucket, so we can
+  /* Print out how far each item is from the slot it hashes to, so we can
      see how even the distribution is. */
   for (slot = 0; slot < table->nbuckets; slot++)
     {
       bc = hash_items (slot, table);
 
       fprintf (stderr, "\tslot %3d: ", slot);
-      for (bcount = 0; bc; bc = bc->next)
-	bcount++;
-
-      fprintf (stderr, "%d\n", bcount);
+      if (bc)
+	fprintf (stderr, "%d\n", PROBE_DISTANCE (table->bucket_hashes[slot], slot, table->nbuckets));
+      else
+	fprintf (stderr, "-\n");
     }
 }
 #endif
@@ -41,8 +41,15 @@ typedef struct bucket_contents {
 
 typedef struct hash_table {
   BUCKET_CONTENTS **bucket_array;	/* Where the data is kept. */
+  unsigned int *bucket_hashes;	/* What each bucket's key hashes to */
   int nbuckets;			/* How many buckets does this table have. */
   int nentries;			/* How many entries does this table have. */
+  /* The buckets of the previous size while the table is being rehashed */
+  BUCKET_CONTENTS **old_array;
+  unsigned int *old_hashes;
+  int old_nbuckets;
+  int old_nentries;		/* How many entries are left to move. */
+  int old_next;			/* The next old bucket to move entries from. */
 } HASH_TABLE;
 
 typedef int hash_wfunc PARAMS((BUCKET_CONTENTS *));
@@ -57,19 +64,24 @@ extern void hash_walk PARAMS((HASH_TABLE *, hash_wfunc *));
 /* Operations to extract information from or pieces of tables */
 extern int hash_bucket PARAMS((const char *, HASH_TABLE *));
 extern int hash_size PARAMS((HASH_TABLE *));
+extern int hash_rehash_finish PARAMS((HASH_TABLE *));
 
 /* Operations on hash table entries */
 extern BUCKET_CONTENTS *hash_search PARAMS((const char *, HASH_TABLE *, int));
+extern BUCKET_CONTENTS *hash_search_hashed PARAMS((const char *, unsigned int, HASH_TABLE *, int));
 extern BUCKET_CONTENTS *hash_insert PARAMS((char *, HASH_TABLE *, int));
 extern BUCKET_CONTENTS *hash_remove PARAMS((const char *, HASH_TABLE *, int));
 
 /* Miscellaneous */
 extern unsigned int hash_string PARAMS((const char *));
 
-/* Redefine the function as a macro for speed. */
+/* Redefine the function as a macro for speed.  Each bucket holds at most
+   one item.  Walks start at bucket 0, which first finishes any rehash in
+   progress so that every item is in bucket_array. */
 #define hash_items(bucket, table) \
 	((table && (bucket < table->nbuckets)) ?  \
-		table->bucket_array[bucket] : \
+		(((bucket) == 0 && table->old_array && hash_rehash_finish (table)), \
+		 table->bucket_array[bucket]) : \
 		(BUCKET_CONTENTS *)NULL)
 
 /* Default number of buckets in the hash table. */
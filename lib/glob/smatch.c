@@ -513,7 +513,7 @@ is_wcclass (wc, name)
    code, since wide character support allows locale-defined char classes.
    This only uses single-byte code, but is only needed to support multibyte
    locales. */
-static int
+int
 posix_cclass_only (pattern)
      char *pattern;
 {
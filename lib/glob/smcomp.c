@@ -0,0 +1,499 @@
+/* smcomp.c -- compile shell patterns into automata for repeated matching */
+
+/* Copyright (C) 2020 Free Software Foundation, Inc.
+
+   This file is part of GNU Bash, the Bourne Again SHell.
+
+   Bash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Bash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Bash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* A pattern made of literal characters, `?', `*' and bracket expressions
+   is an automaton with one state per pattern element.  With few enough
+   elements the set of active states fits in the bits of a word, so the
+   automaton runs over a string in a single pass, a shift and a couple of
+   masks per character, instead of calling strmatch at every position.
+   Patterns this can't represent -- extended glob operators, equivalence
+   classes, collating symbols -- are not compiled, and callers fall back
+   to strmatch. */
+
+#include <config.h>
+
+#include "bashansi.h"
+#include <chartypes.h>
+
+#include "strmatch.h"
+#include "shmbutil.h"
+#include "xmalloc.h"
+
+#if defined (HANDLE_MULTIBYTE)
+extern char *mbsmbchar PARAMS((const char *));
+extern int posix_cclass_only PARAMS((char *));
+#endif
+
+typedef unsigned long smstate_t;
+
+/* The last state is the accepting one */
+#define SM_MAXELEM	((int)(sizeof (smstate_t) * 8) - 1)
+
+#define SM_CHAR		0
+#define SM_ANY		1
+#define SM_BRACKET	2
+#define SM_STAR		3
+
+struct smelem
+{
+  int type;
+  unsigned char c;		/* SM_CHAR */
+  char *bracket;		/* SM_BRACKET: the whole [...], for strmatch */
+};
+
+struct strmatcher
+{
+  int flags;
+  int nelem;
+  struct smelem *elem;
+  smstate_t accept;
+  smstate_t fstar;		/* `*' states, pattern read forwards */
+  smstate_t rstar;		/* `*' states, pattern read backwards */
+  /* The states each byte can advance from.  Filled in the first time a
+     byte is seen, since testing bracket expressions costs a strmatch. */
+  char known[256];
+  smstate_t fwd[256];
+  smstate_t rev[256];
+};
+
+#define FOLD(c, f)	(((f) & FNM_CASEFOLD) ? TOLOWER ((unsigned char)(c)) \
+					      : (unsigned char)(c))
+
+/* Stepping from a `*' state also enters the state after it; consecutive
+   stars are compiled as one, so a single step closes the set. */
+#define SM_CLOSE(s, star)	((s) | (((s) & (star)) << 1))
+#define SM_STEP(s, adv, star) \
+	SM_CLOSE ((((s) & (adv)) << 1) | ((s) & (star)), (star))
+
+/* Return a pointer to the `]' closing the bracket expression starting at P,
+   or NULL if it is unterminated or uses something other than characters,
+   ranges, escapes and character classes, whose extent is easier left to
+   strmatch to work out. */
+static char *
+bracket_end (p)
+     char *p;
+{
+  char *q, *t;
+
+  q = p + 1;
+  if (*q == '!' || *q == '^')
+    q++;
+  if (*q == ']')
+    q++;
+  for ( ; *q; q++)
+    {
+      if (*q == ']')
+	return q;
+      else if (*q == '\\')
+	{
+	  if (*++q == '\0')
+	    return ((char *)NULL);
+	}
+      else if (*q == '[' && (q[1] == '=' || q[1] == '.'))
+	return ((char *)NULL);
+      else if (*q == '[' && q[1] == ':')
+	{
+	  if (q[-1] == '-')
+	    return ((char *)NULL);
+	  for (t = q + 2; ISALPHA ((unsigned char)*t); t++)
+	    ;
+	  if (t == q + 2 || t[0] != ':' || t[1] != ']')
+	    return ((char *)NULL);
+	  q = t + 1;
+	}
+    }
+  return ((char *)NULL);
+}
+
+static int
+elem_matches (e, c, flags)
+     struct smelem *e;
+     int c, flags;
+{
+  char s[2];
+
+  switch (e->type)
+    {
+    case SM_CHAR:
+      return (FOLD (c, flags) == FOLD (e->c, flags));
+    case SM_ANY:
+      return 1;
+    case SM_BRACKET:
+      s[0] = c;
+      s[1] = '\0';
+      return (strmatch (e->bracket, s, flags) == 0);
+    }
+  return 0;
+}
+
+static void
+learn_char (m, c)
+     STRMATCHER *m;
+     int c;
+{
+  int i;
+
+  m->fwd[c] = m->rev[c] = 0;
+  for (i = 0; i < m->nelem; i++)
+    if (m->elem[i].type != SM_STAR && elem_matches (&m->elem[i], c, m->flags))
+      {
+	m->fwd[c] |= (smstate_t)1 << i;
+	m->rev[c] |= (smstate_t)1 << (m->nelem - 1 - i);
+      }
+  m->known[c] = 1;
+}
+
+#define ADVANCE(m, c, dir) \
+	((m)->known[c] ? (m)->dir[c] : (learn_char ((m), (c)), (m)->dir[c]))
+
+/* Compile PATTERN for matching with FLAGS, as strmatch would.  Returns
+   NULL if the pattern can't be compiled. */
+STRMATCHER *
+strmatch_compile (pattern, flags)
+     char *pattern;
+     int flags;
+{
+  STRMATCHER *m;
+  struct smelem *e;
+  char *p, *q;
+  int i;
+
+  if (pattern == 0 || (flags & (FNM_PATHNAME|FNM_NOESCAPE|FNM_PERIOD|FNM_LEADING_DIR|FNM_FIRSTCHAR)))
+    return ((STRMATCHER *)NULL);
+#if defined (HANDLE_MULTIBYTE)
+  /* Only where strmatch would match byte by byte */
+  if (MB_CUR_MAX > 1 && (mbsmbchar (pattern) || posix_cclass_only (pattern) == 0))
+    return ((STRMATCHER *)NULL);
+#endif
+
+  m = (STRMATCHER *)xmalloc (sizeof (STRMATCHER));
+  m->flags = flags;
+  m->nelem = 0;
+  /* Never more elements than pattern characters */
+  i = strlen (pattern);
+  m->elem = (struct smelem *)xmalloc ((i < SM_MAXELEM ? i + 1 : SM_MAXELEM) * sizeof (struct smelem));
+  m->fstar = m->rstar = 0;
+
+  for (p = pattern; *p; )
+    {
+      if ((flags & FNM_EXTMATCH) && p[1] == '(' && strchr ("?*+@!", *p))
+	goto fail;
+      if (*p == '*' && m->nelem && m->elem[m->nelem - 1].type == SM_STAR)
+	{
+	  p++;
+	  continue;
+	}
+      if (m->nelem == SM_MAXELEM)
+	goto fail;
+
+      e = &m->elem[m->nelem++];
+      e->bracket = 0;
+      switch (*p)
+	{
+	case '*':
+	  e->type = SM_STAR;
+	  p++;
+	  break;
+	case '?':
+	  e->type = SM_ANY;
+	  p++;
+	  break;
+	case '\\':
+	  /* A trailing backslash matches only itself at the end of the
+	     string; leave that to strmatch. */
+	  if (p[1] == '\0')
+	    goto fail;
+	  e->type = SM_CHAR;
+	  e->c = p[1];
+	  p += 2;
+	  break;
+	case '[':
+	  if ((q = bracket_end (p)) == 0)
+	    goto fail;
+	  e->type = SM_BRACKET;
+	  e->bracket = (char *)xmalloc (q - p + 2);
+	  memcpy (e->bracket, p, q - p + 1);
+	  e->bracket[q - p + 1] = '\0';
+	  p = q + 1;
+	  break;
+	default:
+	  e->type = SM_CHAR;
+	  e->c = *p++;
+	  break;
+	}
+    }
+
+  for (i = 0; i < m->nelem; i++)
+    if (m->elem[i].type == SM_STAR)
+      {
+	m->fstar |= (smstate_t)1 << i;
+	m->rstar |= (smstate_t)1 << (m->nelem - 1 - i);
+      }
+  m->accept = (smstate_t)1 << m->nelem;
+  memset (m->known, 0, sizeof (m->known));
+  return m;
+
+fail:
+  strmatch_dispose (m);
+  return ((STRMATCHER *)NULL);
+}
+
+void
+strmatch_dispose (m)
+     STRMATCHER *m;
+{
+  int i;
+
+  if (m == 0)
+    return;
+  for (i = 0; i < m->nelem; i++)
+    if (m->elem[i].bracket)
+      free (m->elem[i].bracket);
+  free (m->elem);
+  free (m);
+}
+
+/* Return non-zero if M is made of nothing but `*' and ASCII characters
+   compared as they are.  Matching such a pattern byte by byte against a
+   UTF-8 string gives the same result as matching it character by
+   character, since an ASCII byte is never part of a longer character. */
+int
+strmatch_bytewise (m)
+     STRMATCHER *m;
+{
+  int i;
+
+  if (m->flags & FNM_CASEFOLD)
+    return 0;
+  for (i = 0; i < m->nelem; i++)
+    if (m->elem[i].type == SM_CHAR ? m->elem[i].c >= 0x80 : m->elem[i].type != SM_STAR)
+      return 0;
+  return 1;
+}
+
+/* Match all of STRING against M.  Returns 0 if it matches, FNM_NOMATCH
+   if not, like strmatch. */
+int
+strmatch_compiled (m, string)
+     STRMATCHER *m;
+     char *string;
+{
+  smstate_t s;
+  unsigned char *p;
+
+  s = SM_CLOSE ((smstate_t)1, m->fstar);
+  for (p = (unsigned char *)string; *p && s; p++)
+    s = SM_STEP (s, ADVANCE (m, *p, fwd), m->fstar);
+  return ((*p == 0 && (s & m->accept)) ? 0 : FNM_NOMATCH);
+}
+
+/* Find the shortest or LONGEST prefix of STRING, up to END, that M
+   matches.  Returns 1 and sets *EP to the end of the match if there is
+   one, 0 otherwise. */
+int
+strmatch_prefix (m, string, end, longest, ep)
+     STRMATCHER *m;
+     char *string, *end;
+     int longest;
+     char **ep;
+{
+  smstate_t s;
+  char *p;
+  int found;
+
+  s = SM_CLOSE ((smstate_t)1, m->fstar);
+  found = 0;
+  for (p = string; ; p++)
+    {
+      if (s & m->accept)
+	{
+	  *ep = p;
+	  found = 1;
+	  if (longest == 0)
+	    break;
+	}
+      if (p == end)
+	break;
+      s = SM_STEP (s, ADVANCE (m, (unsigned char)*p, fwd), m->fstar);
+      if (s == 0)
+	break;
+    }
+  return found;
+}
+
+/* Find the shortest or LONGEST suffix of STRING, ending at END, that M
+   matches, running the pattern backwards from the end.  Returns 1 and
+   sets *SP to the start of the match if there is one, 0 otherwise. */
+int
+strmatch_suffix (m, string, end, longest, sp)
+     STRMATCHER *m;
+     char *string, *end;
+     int longest;
+     char **sp;
+{
+  smstate_t s;
+  char *p;
+  int found;
+
+  s = SM_CLOSE ((smstate_t)1, m->rstar);
+  found = 0;
+  for (p = end; ; p--)
+    {
+      if (s & m->accept)
+	{
+	  *sp = p;
+	  found = 1;
+	  if (longest == 0)
+	    break;
+	}
+      if (p == string)
+	break;
+      s = SM_STEP (s, ADVANCE (m, (unsigned char)p[-1], rev), m->rstar);
+      if (s == 0)
+	break;
+    }
+  return found;
+}
+
+/* Return a new array with one flag for each position of STRING from its
+   start through END, set if a match of M starts there.  One backwards pass
+   starts a match at every position and notes where one completes. */
+char *
+strmatch_starts (m, string, end)
+     STRMATCHER *m;
+     char *string, *end;
+{
+  smstate_t s, start;
+  char *ret, *p;
+
+  ret = (char *)xmalloc (end - string + 1);
+  start = SM_CLOSE ((smstate_t)1, m->rstar);
+  s = 0;
+  for (p = end; ; p--)
+    {
+      s |= start;
+      ret[p - string] = (s & m->accept) != 0;
+      if (p == string)
+	break;
+      s = SM_STEP (s, ADVANCE (m, (unsigned char)p[-1], rev), m->rstar);
+    }
+  return ret;
+}
+
+/* Compiled patterns are cached so that loops matching the same patterns
+   over and over compile each of them once.  The cache is a small table
+   indexed by a hash of the pattern; a pattern that can't be compiled is
+   remembered too, so it goes straight to strmatch next time.  What a
+   compiled bracket expression matches depends on the locale and on
+   glob_asciirange, so the entries record the latter and strmatch_flush
+   empties the cache when the locale changes. */
+
+#define SM_CACHE_SIZE	32		/* a power of two */
+
+struct smcache
+{
+  char *pattern;		/* NULL if the slot is empty */
+  int flags;
+  int asciirange;
+  STRMATCHER *m;		/* NULL if PATTERN can't be compiled */
+};
+
+static struct smcache smcache[SM_CACHE_SIZE];
+
+extern int glob_asciirange;
+
+static unsigned int
+hash_pattern (pattern, flags)
+     char *pattern;
+     int flags;
+{
+  unsigned int h;
+  unsigned char *p;
+
+  /* FNV-1a */
+  h = 2166136261u ^ flags;
+  for (p = (unsigned char *)pattern; *p; p++)
+    h = (h ^ *p) * 16777619u;
+  return h;
+}
+
+/* Return the compiled form of PATTERN for matching with FLAGS, compiling it
+   if it isn't in the cache, or NULL if it can't be compiled.  The cache
+   owns what this returns; it stays valid until the next call. */
+STRMATCHER *
+strmatch_lookup (pattern, flags)
+     char *pattern;
+     int flags;
+{
+  struct smcache *c;
+
+  c = &smcache[hash_pattern (pattern, flags) & (SM_CACHE_SIZE - 1)];
+  if (c->pattern && c->flags == flags && c->asciirange == glob_asciirange &&
+      strcmp (c->pattern, pattern) == 0)
+    return (c->m);
+
+  if (c->pattern)
+    {
+      free (c->pattern);
+      strmatch_dispose (c->m);
+    }
+  c->pattern = (char *)xmalloc (strlen (pattern) + 1);
+  strcpy (c->pattern, pattern);
+  c->flags = flags;
+  c->asciirange = glob_asciirange;
+  c->m = strmatch_compile (pattern, flags);
+  return (c->m);
+}
+
+/* Empty the cache of compiled patterns */
+void
+strmatch_flush ()
+{
+  int i;
+
+  for (i = 0; i < SM_CACHE_SIZE; i++)
+    if (smcache[i].pattern)
+      {
+	free (smcache[i].pattern);
+	strmatch_dispose (smcache[i].m);
+	smcache[i].pattern = 0;
+	smcache[i].m = 0;
+      }
+}
+
+/* A drop-in replacement for strmatch that uses the cached compiled form
+   of PATTERN when STRING can be matched byte by byte. */
+int
+strmatch_cached (pattern, string, flags)
+     char *pattern, *string;
+     int flags;
+{
+  STRMATCHER *m;
+
+  if (string == 0 || pattern == 0)
+    return FNM_NOMATCH;
+
+  m = strmatch_lookup (pattern, flags);
+#if defined (HANDLE_MULTIBYTE)
+  if (m && MB_CUR_MAX > 1 && mbsmbchar (string))
+    m = 0;
+#endif
+  return (m ? strmatch_compiled (m, string) : strmatch (pattern, string, flags));
+}
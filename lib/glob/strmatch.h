@@ -61,4 +61,21 @@ extern int strmatch PARAMS((char *, char *, int));
 extern int wcsmatch PARAMS((wchar_t *, wchar_t *, int));
 #endif
 
+/* A pattern compiled for repeated matching against single-byte strings;
+   see smcomp.c. */
+typedef struct strmatcher STRMATCHER;
+
+extern STRMATCHER *strmatch_compile PARAMS((char *, int));
+extern void strmatch_dispose PARAMS((STRMATCHER *));
+extern int strmatch_prefix PARAMS((STRMATCHER *, char *, char *, int, char **));
+extern int strmatch_suffix PARAMS((STRMATCHER *, char *, char *, int, char **));
+extern char *strmatch_starts PARAMS((STRMATCHER *, char *, char *));
+extern int strmatch_compiled PARAMS((STRMATCHER *, char *));
+extern int strmatch_bytewise PARAMS((STRMATCHER *));
+
+/* Compiled patterns, cached by pattern and flags */
+extern STRMATCHER *strmatch_lookup PARAMS((char *, int));
+extern void strmatch_flush PARAMS((void));
+extern int strmatch_cached PARAMS((char *, char *, int));
+
 #endif /* _STRMATCH_H */
@@ -41,14 +41,96 @@
 
 extern int glob_ignore_case, match_ignore_case;
 
+/* Loops applying the same few regular expressions to many strings would
+   otherwise compile them again for every match, so the most recently used
+   compiled expressions are kept, most recent first. */
+#define REGEX_CACHE_SIZE	8
+
+struct regex_cache
+{
+  char *pattern;
+  int rflags;
+  regex_t *regex;
+};
+
+static struct regex_cache regex_cache[REGEX_CACHE_SIZE];
+static int regex_cache_len;
+
+/* The match offsets, reused from one match to the next */
+static regmatch_t *matches;
+static size_t matches_size;
+
+/* Return the compiled form of PATTERN with RFLAGS, compiling it and adding
+   it to the cache if necessary, or NULL if PATTERN is invalid.  The
+   result stays valid until it is evicted or the cache is flushed. */
+static regex_t *
+regex_lookup (pattern, rflags)
+     const char *pattern;
+     int rflags;
+{
+  struct regex_cache c;
+  regex_t *regex;
+  int i;
+
+  for (i = 0; i < regex_cache_len; i++)
+    if (regex_cache[i].rflags == rflags && STREQ (regex_cache[i].pattern, pattern))
+      break;
+
+  if (i < regex_cache_len)
+    c = regex_cache[i];
+  else
+    {
+      regex = (regex_t *)xmalloc (sizeof (regex_t));
+      if (regcomp (regex, pattern, rflags))
+	{
+	  free (regex);
+	  return ((regex_t *)NULL);
+	}
+      c.regex = regex;
+      c.pattern = savestring (pattern);
+      c.rflags = rflags;
+      if (regex_cache_len < REGEX_CACHE_SIZE)
+	i = regex_cache_len++;
+      else
+	{
+	  /* Evict the least recently used */
+	  i = REGEX_CACHE_SIZE - 1;
+	  free (regex_cache[i].pattern);
+	  regfree (regex_cache[i].regex);
+	  free (regex_cache[i].regex);
+	}
+    }
+
+  /* Move it to the front */
+  memmove (regex_cache + 1, regex_cache, i * sizeof (struct regex_cache));
+  regex_cache[0] = c;
+  return (c.regex);
+}
+
+/* Discard the compiled regular expressions; what they match depends on
+   the locale. */
+void
+sh_regflush ()
+{
+  int i;
+
+  for (i = 0; i < regex_cache_len; i++)
+    {
+      free (regex_cache[i].pattern);
+      regfree (regex_cache[i].regex);
+      free (regex_cache[i].regex);
+    }
+  regex_cache_len = 0;
+}
+
 int
 sh_regmatch (string, pattern, flags)
      const char *string;
      const char *pattern;
      int flags;
 {
-  regex_t regex = { 0 };
-  regmatch_t *matches;
+  regex_t *regex;
+  size_t nmatch;
   int rflags;
 #if defined (ARRAY_VARS)
   SHELL_VAR *rematch;
@@ -70,17 +152,22 @@ sh_regmatch (string, pattern, flags)
   rflags |= REG_NOSUB;
 #endif
 
-  if (regcomp (&regex, pattern, rflags))
+  if ((regex = regex_lookup (pattern, rflags)) == 0)
     return 2;		/* flag for printing a warning here. */
 
 #if defined (ARRAY_VARS)
-  matches = (regmatch_t *)malloc (sizeof (regmatch_t) * (regex.re_nsub + 1));
+  nmatch = regex->re_nsub + 1;
+  if (nmatch > matches_size)
+    {
+      matches = (regmatch_t *)xrealloc (matches, nmatch * sizeof (regmatch_t));
+      matches_size = nmatch;
+    }
 #else
-  matches = NULL;
+  nmatch = 0;
 #endif
 
   /* man regexec: NULL PMATCH ignored if NMATCH == 0 */
-  if (regexec (&regex, string, matches ? regex.re_nsub + 1 : 0, matches, 0))
+  if (regexec (regex, string, nmatch, nmatch ? matches : 0, 0))
     result = EXECUTION_FAILURE;
   else
     result = EXECUTION_SUCCESS;		/* match */
@@ -96,13 +183,19 @@ sh_regmatch (string, pattern, flags)
   rematch = make_new_array_variable ("BASH_REMATCH");
   amatch = array_cell (rematch);
 
-  if (matches && (flags & SHMAT_SUBEXP) && result == EXECUTION_SUCCESS && subexp_str)
+  if ((flags & SHMAT_SUBEXP) && result == EXECUTION_SUCCESS && subexp_str)
     {
-      for (subexp_ind = 0; subexp_ind <= regex.re_nsub; subexp_ind++)
+      for (subexp_ind = 0; subexp_ind < nmatch; subexp_ind++)
 	{
-	  memset (subexp_str, 0, subexp_len);
-	  strncpy (subexp_str, string + matches[subexp_ind].rm_so,
-		     matches[subexp_ind].rm_eo - matches[subexp_ind].rm_so);
+	  /* Unmatched subexpressions have offsets of -1 */
+	  if (matches[subexp_ind].rm_so < 0)
+	    subexp_len = 0;
+	  else
+	    {
+	      subexp_len = matches[subexp_ind].rm_eo - matches[subexp_ind].rm_so;
+	      memcpy (subexp_str, string + matches[subexp_ind].rm_so, subexp_len);
+	    }
+	  subexp_str[subexp_len] = '\0';
 	  array_insert (amatch, subexp_ind, subexp_str);
 	}
     }
@@ -112,11 +205,8 @@ sh_regmatch (string, pattern, flags)
 #endif
 
   free (subexp_str);
-  free (matches);
 #endif /* ARRAY_VARS */
 
-  regfree (&regex);
-
   return result;
 }
 
@@ -47,6 +47,7 @@ extern int locale_utf8locale;
 
 extern char *utf8_mbsmbchar (const char *);
 extern int utf8_mblen (const char *, size_t);
+extern size_t utf8_mbstrlen (const char *);
 
 /* Count the number of characters in S, counting multi-byte characters as a
    single character. */
@@ -58,6 +59,9 @@ mbstrlen (s)
   mbstate_t mbs = { 0 }, mbsbak = { 0 };
   int f, mb_cur_max;
 
+  if (locale_utf8locale)
+    return (utf8_mbstrlen (s));
+
   nc = 0;
   mb_cur_max = MB_CUR_MAX;
   while (*s && (clen = (f = is_basic (*s)) ? 1 : mbrlen(s, mb_cur_max, &mbs)) != 0)
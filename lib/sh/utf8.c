@@ -171,25 +171,76 @@ utf8_mblen (s, n)
   return -1;
 }
 
-/* We can optimize this if we know the locale is UTF-8, but needs to handle
-   malformed byte sequences. */
+/* Return the length of the non-ASCII character at S, with N bytes left in
+   the string, counted the way mbrlen would: an invalid or incomplete
+   sequence is one byte.  C libraries disagree about lead bytes from 0xf4
+   up (glibc accepts code points above U+10FFFF), so those go to mbrlen. */
+static size_t
+utf8_charlen (s, n)
+     const char *s;
+     size_t n;
+{
+  size_t clen;
+  mbstate_t mbs = { 0 };
+
+  if ((unsigned char)*s >= 0xf4)
+    clen = mbrlen (s, n, &mbs);
+  else
+    clen = (size_t)utf8_mblen (s, n);
+  return ((MB_INVALIDCH (clen) || clen == 0) ? 1 : clen);
+}
+
+/* Runs of ASCII are classified a word at a time: a word is all ASCII if
+   none of its bytes has the eighth bit set. */
+#define UTF8_HIGHBITS	((unsigned long)-1 / 0xff * 0x80)
+#define UTF8_ASCIIWORD(w)	(((w) & UTF8_HIGHBITS) == 0)
+
+/* Advance up to N characters through S, which ends at END, and return a
+   pointer to where that stops.  If NCP is non-null, the number of
+   characters advanced over is added to it. */
+char *
+utf8_mbsadvance (s, end, n, ncp)
+     const char *s, *end;
+     size_t n, *ncp;
+{
+  size_t left;
+  unsigned long w;
+
+  for (left = n; s < end && left; )
+    {
+      if (UTF8_SINGLEBYTE (*s) == 0)
+	{
+	  s += utf8_charlen (s, end - s);
+	  left--;
+	  continue;
+	}
+      if (left >= sizeof (w) && (size_t)(end - s) >= sizeof (w))
+	{
+	  memcpy (&w, s, sizeof (w));
+	  if (UTF8_ASCIIWORD (w))
+	    {
+	      s += sizeof (w);
+	      left -= sizeof (w);
+	      continue;
+	    }
+	}
+      s++;
+      left--;
+    }
+  if (ncp)
+    *ncp += n - left;
+  return ((char *)s);
+}
+
+/* Count the characters in S without converting it to wide characters. */
 size_t
 utf8_mbstrlen(s)
      const char *s;
 {
-  size_t clen, nc;
-  int mb_cur_max;
+  size_t nc;
 
   nc = 0;
-  mb_cur_max = MB_CUR_MAX;
-  while (*s && (clen = (size_t)utf8_mblen(s, mb_cur_max)) != 0)
-    {
-      if (MB_INVALIDCH(clen))
-	clen = 1;	/* assume single byte */
-
-      s += clen;
-      nc++;
-    }
+  utf8_mbsadvance (s, s + strlen (s), (size_t)-1, &nc);
   return nc;
 }
 
@@ -39,6 +39,8 @@
 #include "shell.h"
 #include "input.h"	/* For bash_input */
 
+#include <glob/strmatch.h>
+
 #ifndef errno
 extern int errno;
 #endif
@@ -229,6 +231,10 @@ set_locale_var (var, value)
       local_shiftstates = 0;
 #  endif
       u32reset ();
+      strmatch_flush ();
+#if defined (HAVE_POSIX_REGEXP)
+      sh_regflush ();
+#endif
       return r;
 #else
       return (1);
@@ -253,6 +259,10 @@ set_locale_var (var, value)
 	  local_shiftstates = 0;
 #endif
 	  u32reset ();
+	  strmatch_flush ();
+#if defined (HAVE_POSIX_REGEXP)
+	  sh_regflush ();
+#endif
 	}
 #  endif
     }
@@ -260,7 +270,13 @@ set_locale_var (var, value)
     {
 #  if defined (LC_COLLATE)
       if (lc_all == 0 || *lc_all == '\0')
-	x = setlocale (LC_COLLATE, get_locale_var ("LC_COLLATE"));
+	{
+	  x = setlocale (LC_COLLATE, get_locale_var ("LC_COLLATE"));
+	  strmatch_flush ();	/* bracket expression ranges collate */
+#if defined (HAVE_POSIX_REGEXP)
+	  sh_regflush ();
+#endif
+	}
 #  endif /* LC_COLLATE */
     }
   else if (var[3] == 'M' && var[4] == 'E')	/* LC_MESSAGES */
@@ -394,6 +410,10 @@ reset_locale_vars ()
   local_shiftstates = 0;
 #  endif
   u32reset ();
+  strmatch_flush ();
+#  if defined (HAVE_POSIX_REGEXP)
+  sh_regflush ();
+#  endif
 #endif
   return 1;
 }
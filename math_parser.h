@@ -6,6 +6,7 @@
 #include <ctype.h> /* For isdigit() */
 #include <string.h>
 #include <errno.h>
+#include <limits.h> /* For LLONG_MAX */
 
 /* Maximum size of an input expression */
 #define BUFF_SZ 1023
@@ -13,22 +14,52 @@
 #define MAX_TOKENS 256
 /* The mxaimum length of an identifier name */
 #define MAX_IDENT_LENGTH 50
+/* Vector results longer than this are printed with their middle elided */
+#define MAX_PRINT_ELEMS 16
+/* The number of elements printed at either end of an elided vector */
+#define PRINT_EDGE_ELEMS 3
+/* The largest output base, using digits 0-9 then a-z */
+#define MAX_BASE 36
+/* The widest a formatted number may be padded to */
+#define MAX_FORMAT_WIDTH 128
+/* Large enough for any formatted number (digits, separators and prefix) */
+#define FORMAT_BUFF_SZ (2 * MAX_FORMAT_WIDTH + 8)
+/* The most arguments a built-in function accepts */
+#define MAX_BUILTIN_ARGS 4
 
-extern int parse_level;
 /* Prints n spaces inline */
 #define P_SPACE(stds, n) for (int s = 0; s < (n - 1); s++) fprintf(stds, " ");
 
 //#define BASHMATH_DEBUG /* Enable/Disable Debugging */
 
+/*
+ * BASHMATH_STATS counts parse nodes and allocations for the benchmark
+ * (support/mpbench.c), which supplies the counting allocators.
+ */
+#ifdef BASHMATH_STATS
+    extern unsigned long stat_nodes;
+    void* stat_malloc(size_t);
+    void* stat_realloc(void*, size_t);
+    char* stat_strdup(const char*);
+    #undef strdup
+    #define malloc(n) stat_malloc(n)
+    #define realloc(p, n) stat_realloc(p, n)
+    #define strdup(s) stat_strdup(s)
+    #define COUNT_NODE() stat_nodes++
+#else
+    #define COUNT_NODE()
+#endif
+
 #ifdef BASHMATH_DEBUG
     #define DEBUG_PRINT printf
-    #define LEVEL_PRINT P_SPACE(stdout, parse_level); printf
-    #define PARSE_ENTRY P_SPACE(stdout, parse_level); parse_level++; printf
-    #define PARSE_EXIT parse_level--; P_SPACE(stdout, parse_level); printf
+    #define LEVEL_PRINT P_SPACE(stdout, ctx->parse_level); printf
+    #define PARSE_ENTRY COUNT_NODE(); P_SPACE(stdout, ctx->parse_level); \
+        ctx->parse_level++; printf
+    #define PARSE_EXIT ctx->parse_level--; P_SPACE(stdout, ctx->parse_level); printf
 #else
     #define DEBUG_PRINT
     #define LEVEL_PRINT
-    #define PARSE_ENTRY
+    #define PARSE_ENTRY COUNT_NODE();
     #define PARSE_EXIT
 #endif
 
@@ -56,6 +87,12 @@ static const char* token_name[] =
         "Help",
         "Identifier",
         "Assignment",
+        "LBracket",
+        "RBracket",
+        "Comma",
+        "Builtin",
+        "Format",
+        "Watch",
         "Illegal"
     };
 
@@ -82,25 +119,143 @@ typedef enum {
     KW_HELP = 19,
     IDENTIFIER = 20,
     ASSIGN = 21,
-    ILLEGAL = 22
+    LBRACKET = 22,
+    RBRACKET = 23,
+    COMMA = 24,
+    BUILTIN = 25,
+    KW_FORMAT = 26,
+    KW_WATCH = 27,
+    ILLEGAL = 28
 } Terminal;
 
 typedef enum {
     MATCH_ERR = -1,
     BAD_SYNTAX = 1,
     UNEXPECTED_EOF = 2,
-    INP_TOO_LONG = 3
+    INP_TOO_LONG = 3,
+    TOO_MANY_TOKENS = 4
 } Error;
 
+typedef enum {
+    VAL_SCALAR = 0,
+    VAL_VECTOR = 1,
+    VAL_RANGE = 2
+} ValueType;
+
+/*
+ * The result of evaluating an expression. Vectors store their elements in
+ * one contiguous buffer, ranges are only materialised into a vector once
+ * an operation needs their elements.
+ */
+typedef struct {
+    ValueType type;
+    long long val;      /* VAL_SCALAR: the value */
+    long long* elems;   /* VAL_VECTOR: the element buffer */
+    long long len;      /* VAL_VECTOR, VAL_RANGE: the number of elements */
+    long long lo;       /* VAL_RANGE: the first element */
+    int borrowed;       /* 1 if elems belongs to an identifier */
+} Value;
+
+/* How results are printed */
+typedef struct {
+    int base;           /* The output base, 2 to MAX_BASE */
+    int group;          /* Digits per group, 0 to not group digits */
+    int width;          /* Minimum digits, padded with leading zeros */
+    int is_unsigned;    /* 1 to print negative values in two's complement */
+} Format;
+
+/* A function callable from expressions, e.g. hex(255) */
+typedef struct {
+    const char* name;
+    int min_args;
+    int max_args;
+    /* Consumes the evaluated arguments and returns the result */
+    Value (*fn)(Value*, int, int);
+} Builtin;
+
 typedef struct {
     Terminal type;
     long long val;
     char* lvalue;
     int lvalue_is_assigned;
     int col_pos;
+    Value value;        /* The value bound to an identifier token */
 } Token;
 
+/* A watched formula, see mp_watch.c */
+typedef struct Formula Formula;
+
+/*
+ * The state of one BashMath engine: its identifiers, watched formulas and
+ * output format, and the expression being evaluated. Contexts are
+ * independent of one another, so separate contexts may be used at once on
+ * separate threads. Bash evaluates every expression in a single context.
+ */
+typedef struct {
+    /* The input string constituting the input expression */
+    char buffer[BUFF_SZ];
+    /* Used to index the above buffer */
+    int buff_idx;
+    /* The size of the above buffer */
+    int buff_sz;
+    /* Tracks the position of symbols within the expression buffer */
+    int current_column;
+    /* The next character in the buffer */
+    char nextCh;
+    /* An array of Tokens comprising the input expression */
+    Token* token_stream;
+    /* Used to index the stream of tokens (token_stream) */
+    int token_stream_idx;
+    /* The number of tokens in the token_stream */
+    int tokens_in_stream;
+    /* A 2D array of current identifier tokens */
+    Token** identifiers;
+    /* The number of initialised identifier tokens */
+    int identifier_count;
+    /* 1 if an error is encountered, 0 otherwise */
+    int error_encountered;
+    /* Tracks how many functions deep parsing is */
+    int parse_level;
+    /* Incremented for each expression handled */
+    unsigned long evaluation_count;
+    /* How results are printed, as set by the format statement */
+    Format output_format;
+    /* How the result of the current expression will be printed */
+    Format result_format;
+    /* Per base digit pair tables, see format_number() */
+    char* digit_pairs[MAX_BASE + 1];
+    /* Where results and errors are printed */
+    FILE* out;
+    FILE* err;
+    /* The watched formulas */
+    Formula** formulas;
+    int formula_count;
+    int formula_capacity;
+    /* The identifier assigned by the current expression, if any */
+    char* pending_change;
+} MathContext;
+
+/* Each thread has its own current context */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+    #define MP_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+    #define MP_THREAD_LOCAL __thread
+#else
+    #define MP_THREAD_LOCAL
+#endif
+
+/* The context the calling thread is evaluating in, see use_context() */
+extern MP_THREAD_LOCAL MathContext* ctx;
+
+/* Context functions */
+MathContext* make_context(void);
+void        free_context(MathContext*);
+MathContext* use_context(MathContext*);
+int         evaluate_string(MathContext*, const char*, Value*);
+
 void        handle_expression(char*);
+int         scan_expression(const char*);
+Value       evaluate_expression(void);
 
 /* Scanning functions */
 long long   get_numerical_value(char);
@@ -110,7 +265,7 @@ char        get_next_char_report_whitespace(int*);
 Token*      next(void);
 
 /* Identifier functions */
-void        add_identifier(Token*);
+Token*      add_identifier(Token*);
 Token*      get_identifier(char*);
 char*       get_identifier_token(char);
 
@@ -120,25 +275,82 @@ void        syntax_error(Token*, Error);
 void        div_by_zero_error(Terminal);
 void        unknown_seq_error(void);
 void        unassigned_lvalue_err(Token);
+void        length_mismatch_err(int, long long, long long);
+void        scalar_expected_err(int);
+void        range_overflow_err(int);
+void        vector_alloc_err(long long);
+void        shell_var_err(int, char*, const char*);
+void        builtin_args_err(int, const Builtin*, int);
+void        builtin_arg_err(int, const char*, const char*);
+void        format_option_err(int, const char*);
+void        circular_dependency_err(int, const char*);
 void        paren_error(Terminal, int);
 void        stop_parsing(void);
 void        display_help(void);
 
+/* Value functions */
+Value       make_scalar(long long);
+Value       make_range(long long, long long, int);
+Value       make_vector(long long);
+Value       borrow_value(Value);
+Value       own_value(Value);
+void        free_value(Value*);
+void        materialise(Value*);
+long long   scalar_of(Value, int);
+long long   sum_value(Value);
+long long   exponentiate(long long, long long);
+Value       binary_op(Terminal, Value, Value, int);
+Value       negate_value(Value);
+void        print_value(Value, const Format*);
+
+/* Output formatting functions */
+void        reset_format(Format*);
+char*       format_number(long long, const Format*, char*);
+
+/* Number theory functions */
+int         is_prime(unsigned long long);
+unsigned long long next_prime(unsigned long long, unsigned long long);
+int         factorise(unsigned long long, unsigned long long*);
+long long   count_primes(unsigned long long, unsigned long long, long long*);
+
+/* Built-in function functions */
+const Builtin* find_builtin(const char*);
+
+/* Shell variable functions */
+int         shell_variable_exists(char*);
+int         shell_variable_value(char*, Value*, int);
+Value       shell_variable_assign(char*, Value, int);
+int         shell_interrupted(void);
+
+/* Watched formula functions */
+int         watch_formula(char*, int, int, int);
+void        unwatch(const char*);
+void        note_change(const char*);
+void        propagate_change(void);
+void        list_watches(void);
+void        free_watches(void);
+
 /* Parsing functions */
-long long   parse_block(void);
-long long   parse_assignment(void);
-long long   parse_summation(void);
+Value       parse_block(void);
+void        parse_format(void);
+Value       parse_builtin(void);
+Value       parse_watch(void);
+Value       parse_assignment(void);
+Value       parse_summation(void);
 void        parse_subrange(int*, int*);
-long long   parse_exp(void);
-long long   parse_bitwise_or(void);
-long long   parse_bitwise_xor(void);
-long long   parse_bitwise_and(void);
-long long   parse_bitshift(void);
-long long   parse_arith(void);
-long long   parse_term(void);
-long long   parse_exponent(void);
-long long   parse_factor(void);
+Value       parse_vector(void);
+Value       parse_exp(void);
+Value       parse_bitwise_or(void);
+Value       parse_bitwise_xor(void);
+Value       parse_bitwise_and(void);
+Value       parse_bitshift(void);
+Value       parse_arith(void);
+Value       parse_term(void);
+Value       parse_exponent(void);
+Value       parse_factor(void);
 Token*      parse_get_lvalue(void);
+int         binds_shell_variable(Token*);
+Value       assign_lvalue(Token*, Value, int, int);
 int         is_match(Terminal);
 int         match(Terminal);
 Token       peek_token(void);
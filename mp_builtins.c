@@ -0,0 +1,191 @@
+#include "math_parser.h"
+
+/* The largest prime a long long can hold */
+#define MAX_LL_PRIME 9223372036854775783LL
+
+/*
+ * hex(x), oct(x) and bin(x) return x unchanged, but cause the result of
+ * the expression to be printed in that base.
+ */
+static Value builtin_hex(Value* args, int nargs, int col_pos)
+{
+    ctx->result_format.base = 16;
+    return args[0];
+}
+
+static Value builtin_oct(Value* args, int nargs, int col_pos)
+{
+    ctx->result_format.base = 8;
+    return args[0];
+}
+
+static Value builtin_bin(Value* args, int nargs, int col_pos)
+{
+    ctx->result_format.base = 2;
+    return args[0];
+}
+
+/*
+ * base(x, b) returns x unchanged, but causes the result of the expression
+ * to be printed in base b.
+ */
+static Value builtin_base(Value* args, int nargs, int col_pos)
+{
+    long long base = scalar_of(args[1], col_pos);
+    if (base < 2 || base > MAX_BASE)
+        builtin_arg_err(col_pos, "base", "base must be between 2 and 36");
+    else
+        ctx->result_format.base = base;
+    return args[0];
+}
+
+/*
+ * Counts the primes in a range, ignoring any part of it below zero.
+ *
+ * range: The range to count the primes of
+ * flags: If not NULL, set to 1 for each prime element and 0 otherwise
+ *
+ * returns: The number of primes, or -1 if the count was interrupted
+ */
+static long long range_primes(Value range, long long* flags)
+{
+    long long hi = range.lo + range.len - 1;
+    long long lo = range.lo < 0 ? 0 : range.lo;
+
+    if (flags != NULL)
+        memset(flags, 0, range.len * sizeof(long long));
+    if (range.len == 0 || hi < lo)
+        return 0;
+    return count_primes(lo, hi, flags ? flags + (lo - range.lo) : NULL);
+}
+
+/*
+ * Returns an owned vector holding the elements of a vector or range
+ */
+static Value owned_elements(Value value)
+{
+    materialise(&value);
+    return own_value(value);
+}
+
+/*
+ * isprime(x) returns 1 if x is prime and 0 otherwise. Given a vector or
+ * range it returns a vector of the result for each element; ranges are
+ * sieved rather than tested element by element.
+ */
+static Value builtin_isprime(Value* args, int nargs, int col_pos)
+{
+    Value x = args[0];
+
+    if (x.type == VAL_SCALAR)
+        return make_scalar(x.val > 0 && is_prime(x.val));
+    if (x.type == VAL_RANGE) {
+        Value flags = make_vector(x.len);
+        if (flags.type == VAL_VECTOR && range_primes(x, flags.elems) < 0)
+            builtin_arg_err(col_pos, "isprime", "interrupted");
+        return flags;
+    }
+
+    x = owned_elements(x);
+    for (long long i = 0; i < x.len; i++)
+        x.elems[i] = x.elems[i] > 0 && is_prime(x.elems[i]);
+    return x;
+}
+
+/*
+ * nextprime(x) returns the smallest prime greater than x, element by
+ * element for vectors and ranges.
+ */
+static Value builtin_nextprime(Value* args, int nargs, int col_pos)
+{
+    Value x = args[0];
+    int is_scalar = (x.type == VAL_SCALAR);
+    long long* elems = is_scalar ? &x.val : NULL;
+
+    if (!is_scalar) {
+        x = owned_elements(x);
+        elems = x.elems;
+    }
+    for (long long i = 0; i < (is_scalar ? 1 : x.len); i++) {
+        if (elems[i] >= MAX_LL_PRIME) {
+            builtin_arg_err(col_pos, "nextprime",
+                "no larger prime fits in 64 bits");
+            break;
+        }
+        elems[i] = next_prime(elems[i] < 0 ? 0 : elems[i], MAX_LL_PRIME + 1);
+    }
+    return x;
+}
+
+/*
+ * factor(n) returns a vector of the prime factors of n in ascending order,
+ * each repeated by its multiplicity; factor(1) is empty.
+ */
+static Value builtin_factor(Value* args, int nargs, int col_pos)
+{
+    unsigned long long factors[64];
+    long long n = scalar_of(args[0], col_pos);
+
+    if (n < 1) {
+        builtin_arg_err(col_pos, "factor", "n must be positive");
+        return make_scalar(0);
+    }
+
+    int count = factorise(n, factors);
+    Value result = make_vector(count);
+    for (int i = 0; i < count && result.type == VAL_VECTOR; i++)
+        result.elems[i] = factors[i];
+    return result;
+}
+
+/*
+ * primecount(a...b) returns the number of primes from a to b inclusive,
+ * counted with a segmented sieve. primecount(n) counts the primes up to n
+ * and primecount of a vector counts its prime elements.
+ */
+static Value builtin_primecount(Value* args, int nargs, int col_pos)
+{
+    Value x = args[0];
+    long long count = 0;
+
+    if (x.type == VAL_SCALAR)
+        count = x.val < 2 ? 0 : count_primes(2, x.val, NULL);
+    else if (x.type == VAL_RANGE)
+        count = range_primes(x, NULL);
+    else {
+        for (long long i = 0; i < x.len; i++)
+            count += x.elems[i] > 0 && is_prime(x.elems[i]);
+        free_value(&x);
+    }
+    if (count < 0)
+        builtin_arg_err(col_pos, "primecount", "interrupted");
+    return make_scalar(count);
+}
+
+/* The functions callable from expressions */
+static const Builtin builtins[] = {
+    { "hex", 1, 1, builtin_hex },
+    { "oct", 1, 1, builtin_oct },
+    { "bin", 1, 1, builtin_bin },
+    { "base", 2, 2, builtin_base },
+    { "isprime", 1, 1, builtin_isprime },
+    { "nextprime", 1, 1, builtin_nextprime },
+    { "factor", 1, 1, builtin_factor },
+    { "primecount", 1, 1, builtin_primecount }
+};
+
+/*
+ * Returns the built-in function with the specified name
+ *
+ *    name: The name of the built-in function
+ *
+ * returns: The built-in function, or NULL if there is no such function
+ */
+const Builtin* find_builtin(const char* name)
+{
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(Builtin); i++) {
+        if (strcmp(builtins[i].name, name) == 0)
+            return &builtins[i];
+    }
+    return NULL;
+}
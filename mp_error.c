@@ -1,9 +1,5 @@
 #include "math_parser.h"
 
-/* The buffer containing the input expression */
-extern char buffer[BUFF_SZ];
-/* 1 if an error has been encountered, 0 otherwise */
-extern int error_encountered;
 
 /*
  * Prints an error message to stderr stating that a symbol was encountered
@@ -11,10 +7,10 @@ extern int error_encountered;
  */
 void unknown_seq_error()
 {
-    fprintf(stderr, "%s\n", buffer);
+    fprintf(ctx->err, "%s\n", ctx->buffer);
     int at_pos = peek_token().col_pos;
-    P_SPACE(stderr, at_pos);
-    fprintf(stderr, "^ Error: First in unknown sequence\n");
+    P_SPACE(ctx->err, at_pos);
+    fprintf(ctx->err, "^ Error: First in unknown sequence\n");
 }
 
 /*
@@ -29,13 +25,15 @@ void unknown_seq_error()
 void syntax_error(Token* token, Error e)
 {
     if (e == UNEXPECTED_EOF)
-        fprintf(stderr, "Unexpected End of file\n");
+        fprintf(ctx->err, "Unexpected End of file\n");
     else if (e == BAD_SYNTAX) {
-        fprintf(stderr, "%s\n", buffer);
-        P_SPACE(stderr, token->col_pos);
-        fprintf(stderr, "^ Error: Syntax error\n");
+        fprintf(ctx->err, "%s\n", ctx->buffer);
+        P_SPACE(ctx->err, token->col_pos);
+        fprintf(ctx->err, "^ Error: Syntax error\n");
     } else if (e == INP_TOO_LONG)
-        fprintf(stderr, "Error: Input too long\n");
+        fprintf(ctx->err, "Error: Input too long\n");
+    else if (e == TOO_MANY_TOKENS)
+        fprintf(ctx->err, "Error: Too many tokens (at most %d)\n", MAX_TOKENS);
 }
 
 /*
@@ -49,14 +47,14 @@ void syntax_error(Token* token, Error e)
  */
 int match_error(Token encountered, Terminal expected)
 {
-    if (!error_encountered)
+    if (!ctx->error_encountered)
         stop_parsing();
     else
         return MATCH_ERR;
 
-    fprintf(stderr, "%s\n", buffer);
-    P_SPACE(stderr, encountered.col_pos);
-    fprintf(stderr, "^ Error: Expected %s but encountered %s\n",
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, encountered.col_pos);
+    fprintf(ctx->err, "^ Error: Expected %s but encountered %s\n",
         get_token_name(expected), get_token_name(encountered.type));
 
     return MATCH_ERR;
@@ -71,33 +69,39 @@ int match_error(Token encountered, Terminal expected)
  */
 void div_by_zero_error(Terminal offender)
 {
-    if (!error_encountered)
+    if (!ctx->error_encountered)
         stop_parsing();
     else
         return ;
     const char* operator = (offender == DIVIDE ? "Division" : "Modulus");
-    fprintf(stderr, "%s by 0 error\n", operator);
+    fprintf(ctx->err, "%s by 0 error\n", operator);
 }
 
 /*
  * Prints an error to stderr stating that either a left/right parenthesis
- * was unmatched. 
+ * or bracket was unmatched. 
  *
- * missing_paren:    The type of missing parentheses, either LPAREN, or RPAREN
+ * missing_paren:    The type of missing parentheses, either LPAREN, RPAREN,
+ *                   LBRACKET or RBRACKET
  * paired_paren_pos: The position of the parenthesis that was unmatched 
  */
 void paren_error(Terminal missing_paren, int paired_paren_pos)
 {
-    if (!error_encountered)
+    if (!ctx->error_encountered)
         stop_parsing();
     else
         return ;
-    fprintf(stderr, "%s\n", buffer); /* Print originally entered expression */
-    P_SPACE(stderr, paired_paren_pos);
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, paired_paren_pos);
     if (missing_paren == LPAREN)
-        fprintf(stderr, "^ Error: Missing LParen '(' to open\n");
+        fprintf(ctx->err, "^ Error: Missing LParen '(' to open\n");
+    else if (missing_paren == RPAREN)
+        fprintf(ctx->err, "^ Error: Missing RParen ')' to close\n");
+    else if (missing_paren == LBRACKET)
+        fprintf(ctx->err, "^ Error: Missing LBracket '[' to open\n");
     else
-        fprintf(stderr, "^ Error: Missing RParen ')' to close\n");
+        fprintf(ctx->err, "^ Error: Missing RBracket ']' to close\n");
 }
 
 /*
@@ -109,16 +113,196 @@ void paren_error(Terminal missing_paren, int paired_paren_pos)
  */
 void unassigned_lvalue_err(Token unassigned_lvalue)
 {
-    if (!error_encountered)
+    if (!ctx->error_encountered)
         stop_parsing();
     else
         return ;
-    fprintf(stderr, "%s\n", buffer); /* Print originally entered expression */
-    P_SPACE(stderr, unassigned_lvalue.col_pos);
-    fprintf(stderr, "^ Error: Unassigned Identifier '%s'\n",
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, unassigned_lvalue.col_pos);
+    fprintf(ctx->err, "^ Error: Unassigned Identifier '%s'\n",
         unassigned_lvalue.lvalue);
 }
 
+/*
+ * Prints an error to stderr stating that an element-wise operation was
+ * attempted between two vectors of differing lengths.
+ *
+ *   op_pos: The position of the operator applied to the vectors
+ * left_len: The number of elements in the left hand vector
+ * right_len: The number of elements in the right hand vector
+ */
+void length_mismatch_err(int op_pos, long long left_len, long long right_len)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, op_pos);
+    fprintf(ctx->err, "^ Error: Vector lengths differ (%lld and %lld)\n",
+        left_len, right_len);
+}
+
+/*
+ * Prints an error to stderr stating that a vector was used where only a
+ * scalar is permissible (e.g. the bounds of a range).
+ *
+ * exp_pos: The position of the expression that produced the vector
+ */
+void scalar_expected_err(int exp_pos)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, exp_pos);
+    fprintf(ctx->err, "^ Error: Expected a scalar but encountered a vector\n");
+}
+
+/*
+ * Prints an error to stderr stating that a range has too many elements
+ * to be counted.
+ *
+ * exp_pos: The position of the expression that produced the range's end
+ */
+void range_overflow_err(int exp_pos)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, exp_pos);
+    fprintf(ctx->err, "^ Error: Range has too many elements\n");
+}
+
+/*
+ * Prints an error to stderr stating that there was not enough memory to
+ * hold the elements of a vector.
+ *
+ * len: The number of elements that could not be allocated
+ */
+void vector_alloc_err(long long len)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    fprintf(ctx->err,
+        "Error: Not enough memory for a vector of %lld elements\n",
+        len);
+}
+
+/*
+ * Prints an error to stderr stating that a shell variable could not be
+ * used or assigned within an expression.
+ *
+ * lvalue_pos: The position of the identifier naming the shell variable
+ *       name: The name of the shell variable
+ *     reason: A description of the problem
+ */
+void shell_var_err(int lvalue_pos, char* name, const char* reason)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, lvalue_pos);
+    fprintf(ctx->err, "^ Error: Shell variable '%s': %s\n", name, reason);
+}
+
+/*
+ * Prints an error to stderr stating that a built-in function was called
+ * with the wrong number of arguments.
+ *
+ *  call_pos: The position of the built-in function's name
+ *   builtin: The built-in function that was called
+ *     nargs: The number of arguments it was called with
+ */
+void builtin_args_err(int call_pos, const Builtin* builtin, int nargs)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, call_pos);
+    if (builtin->min_args == builtin->max_args)
+        fprintf(ctx->err,
+            "^ Error: %s() takes %d argument(s) but was given %d\n",
+            builtin->name, builtin->min_args, nargs);
+    else
+        fprintf(ctx->err, "^ Error: %s() takes %d to %d arguments but was "
+            "given %d\n", builtin->name, builtin->min_args, builtin->max_args,
+            nargs);
+}
+
+/*
+ * Prints an error to stderr stating that a built-in function was given an
+ * argument it cannot accept.
+ *
+ * call_pos: The position of the built-in function's name
+ *     name: The name of the built-in function
+ *   reason: A description of the problem
+ */
+void builtin_arg_err(int call_pos, const char* name, const char* reason)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, call_pos);
+    fprintf(ctx->err, "^ Error: %s(): %s\n", name, reason);
+}
+
+/*
+ * Prints an error to stderr stating that a format statement contained an
+ * unknown or out of range option.
+ *
+ * option_pos: The position of the offending option
+ *     reason: A description of the problem
+ */
+void format_option_err(int option_pos, const char* reason)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, option_pos);
+    fprintf(ctx->err, "^ Error: %s\n", reason);
+}
+
+/*
+ * Prints an error to stderr stating that a watched formula would depend
+ * on its own value.
+ *
+ * target_pos: The position of the formula's target identifier
+ *     target: The name of the formula's target identifier
+ */
+void circular_dependency_err(int target_pos, const char* target)
+{
+    if (!ctx->error_encountered)
+        stop_parsing();
+    else
+        return ;
+    /* Print originally entered expression */
+    fprintf(ctx->err, "%s\n", ctx->buffer);
+    P_SPACE(ctx->err, target_pos);
+    fprintf(ctx->err, "^ Error: '%s' would depend on itself\n", target);
+}
+
 /*
  * Any fatal error should call stop_parsing() to cause all future
  * calls to is_match() to fail. This as a result effectively stops
@@ -127,5 +311,5 @@ void unassigned_lvalue_err(Token unassigned_lvalue)
  */
 void stop_parsing()
 {
-    error_encountered = 1;
+    ctx->error_encountered = 1;
 }
\ No newline at end of file
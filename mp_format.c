@@ -0,0 +1,144 @@
+#include "math_parser.h"
+
+/* The digit characters of every base up to MAX_BASE */
+static const char digit_chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+/*
+ * Returns the table of digit pairs for a base, building it on first use.
+ * Each context's table for a base holds the two digits of every number
+ * below base * base. Digits are produced two at a time from these tables,
+ * halving the divisions (or shifts) needed to format a number.
+ */
+static const char* get_digit_pairs(int base)
+{
+    if (ctx->digit_pairs[base] != NULL)
+        return ctx->digit_pairs[base];
+
+    char* pairs = malloc(2 * base * base);
+    for (int i = 0; i < base * base; i++) {
+        pairs[2 * i] = digit_chars[i / base];
+        pairs[2 * i + 1] = digit_chars[i % base];
+    }
+    ctx->digit_pairs[base] = pairs;
+    return pairs;
+}
+
+/*
+ * Returns log2 of a base if the base is a power of two, 0 otherwise
+ */
+static int base_shift(int base)
+{
+    int shift = 0;
+    if (base & (base - 1))
+        return 0;
+    while ((1 << shift) < base)
+        shift++;
+    return shift;
+}
+
+/*
+ * Writes the digits of a number backwards, ending just before end.
+ *
+ *     n: The number to write the digits of
+ *  base: The base to write the number in
+ *   end: One past where the last digit is written
+ *
+ * returns: A pointer to the first (most significant) digit
+ */
+static char* generate_digits(unsigned long long n, int base, char* end)
+{
+    const char* pairs = get_digit_pairs(base);
+    unsigned long long base_sq = base * base;
+    int shift = base_shift(base);
+    char* p = end;
+
+    if (shift) {
+        /* Powers of two peel off two digits with a mask and shift */
+        while (n >= base_sq) {
+            p -= 2;
+            memcpy(p, pairs + 2 * (n & (base_sq - 1)), 2);
+            n >>= 2 * shift;
+        }
+    } else {
+        while (n >= base_sq) {
+            unsigned long long q = n / base_sq;
+            p -= 2;
+            memcpy(p, pairs + 2 * (n - q * base_sq), 2);
+            n = q;
+        }
+    }
+
+    if (n >= (unsigned long long)base) {
+        p -= 2;
+        memcpy(p, pairs + 2 * n, 2);
+    } else
+        *--p = digit_chars[n];
+    return p;
+}
+
+/*
+ * Writes the prefix printed before numbers in a base. The prefixes
+ * match those accepted in expressions; other bases use Bash's base#n.
+ */
+static void format_prefix(int base, char* prefix)
+{
+    if (base == 16)
+        strcpy(prefix, "0x");
+    else if (base == 2)
+        strcpy(prefix, "0b");
+    else if (base == 8)
+        strcpy(prefix, "0");
+    else if (base == 10)
+        prefix[0] = '\0';
+    else
+        sprintf(prefix, "%d#", base);
+}
+
+/*
+ * Resets a format to printing signed decimal numbers without grouping
+ * or padding.
+ */
+void reset_format(Format* format)
+{
+    format->base = 10;
+    format->group = 0;
+    format->width = 0;
+    format->is_unsigned = 0;
+}
+
+/*
+ * Formats a number for output.
+ *
+ *    val: The number to format
+ * format: How to format the number
+ *    out: A buffer of at least FORMAT_BUFF_SZ characters
+ *
+ * returns: out, holding the formatted number
+ */
+char* format_number(long long val, const Format* format, char* out)
+{
+    char digits[MAX_FORMAT_WIDTH + 1];
+    char* end = digits + sizeof(digits);
+    int negative = (!format->is_unsigned && val < 0);
+    unsigned long long magnitude = negative ? -(unsigned long long)val
+        : (unsigned long long)val;
+
+    char* start = generate_digits(magnitude, format->base, end);
+    while (end - start < format->width)
+        *--start = '0';
+
+    char* p = out;
+    if (negative)
+        *p++ = '-';
+    format_prefix(format->base, p);
+    p += strlen(p);
+
+    int ndigits = end - start;
+    for (int i = 0; i < ndigits; i++) {
+        if (format->group && i > 0 && (ndigits - i) % format->group == 0)
+            *p++ = '_';
+        *p++ = start[i];
+    }
+    *p = '\0';
+    return out;
+}
@@ -0,0 +1,138 @@
+#include "math_parser.h"
+#include "bashmath.h"
+
+/*
+ * The public interface of libbashmath, see bashmath.h. Each function takes
+ * the context it acts on and fails cleanly when there is none, rather than
+ * relying on the calling thread's current context.
+ */
+
+struct BmContext {
+    MathContext* context;
+};
+
+/*
+ * Returns a new context that prints results to stdout and errors to
+ * stderr, or NULL if it could not be allocated.
+ */
+BmContext* bm_context_new()
+{
+    BmContext* bm = malloc(sizeof(BmContext));
+    if (bm == NULL)
+        return NULL;
+
+    bm->context = make_context();
+    if (bm->context == NULL) {
+        free(bm);
+        return NULL;
+    }
+    return bm;
+}
+
+/*
+ * Frees a context and the values of its identifiers. Values returned by
+ * bm_evaluate() remain valid.
+ */
+void bm_context_free(BmContext* bm)
+{
+    if (bm == NULL)
+        return;
+
+    free_context(bm->context);
+    free(bm);
+}
+
+/*
+ * Sets where a context prints results and errors.
+ *
+ * returns: 0, or -1 if there is no context or stream
+ */
+int bm_set_streams(BmContext* bm, FILE* out, FILE* err)
+{
+    if (bm == NULL || out == NULL || err == NULL)
+        return -1;
+
+    bm->context->out = out;
+    bm->context->err = err;
+    return 0;
+}
+
+/*
+ * Evaluates an expression within a context. Errors are printed to the
+ * context's error stream, and watched formulas recomputed as a result to
+ * its output stream.
+ *
+ *         bm: The context to evaluate the expression in
+ * expression: The expression, a statement as typed after '=' in Bash
+ *     result: Set to the value of the expression, if it has one. Ranges
+ *             are returned as vectors. The caller frees the value with
+ *             bm_value_free().
+ *
+ * returns: 1 if result was set, 0 if the statement has no value (e.g.
+ *          format), or -1 if there is no context or an error was
+ *          encountered
+ */
+int bm_evaluate(BmContext* bm, const char* expression, BmValue* result)
+{
+    if (bm == NULL || expression == NULL || result == NULL)
+        return -1;
+
+    Value value;
+    int status = evaluate_string(bm->context, expression, &value);
+    if (status <= 0)
+        return status;
+
+    MathContext* saved = use_context(bm->context);
+    materialise(&value);
+    use_context(saved);
+    if (bm->context->error_encountered)
+        return -1;
+
+    result->is_vector = value.type == VAL_VECTOR;
+    result->val = value.type == VAL_VECTOR ? 0 : value.val;
+    result->elems = value.type == VAL_VECTOR ? value.elems : NULL;
+    result->len = value.type == VAL_VECTOR ? value.len : 0;
+    return 1;
+}
+
+/*
+ * Prints a value to a context's output stream, in the context's output
+ * format as set by the format statement.
+ *
+ * returns: 0, or -1 if there is no context or value
+ */
+int bm_print(BmContext* bm, const BmValue* value)
+{
+    if (bm == NULL || value == NULL)
+        return -1;
+
+    Value printed = make_scalar(value->val);
+    if (value->is_vector) {
+        printed.type = VAL_VECTOR;
+        printed.elems = value->elems;
+        printed.len = value->len;
+        printed = borrow_value(printed);
+    }
+
+    MathContext* saved = use_context(bm->context);
+    print_value(printed, &ctx->output_format);
+    use_context(saved);
+    return 0;
+}
+
+/*
+ * Releases the elements of a vector returned by bm_evaluate() and resets
+ * the value to a scalar 0.
+ */
+void bm_value_free(BmValue* value)
+{
+    if (value == NULL)
+        return;
+
+    if (value->is_vector)
+        free(value->elems);
+    value->is_vector = 0;
+    value->val = 0;
+    value->elems = NULL;
+    value->len = 0;
+}
@@ -1,31 +1,69 @@
 #include "math_parser.h"
 
-/* A 2D array of current identifier tokens */
-Token** identifiers;
-/* An array of Tokens comprising the input expression */
-Token* token_stream;
-/* The input string constituting the input expression */
-char buffer[BUFF_SZ];
-/* Used to index the above buffer */
-int buff_idx = 0;
-/* The size of the above buffer */
-int buff_sz = 0;
-/* Tracks the position of symbols within the expression buffer */
-int current_column = 0;
-/* The next character in the buffer */
-char nextCh;
-/* Used to index the stream of tokens (token_stream) */
-int token_stream_idx;
-/* The number of initialised identifier tokens */
-int identifier_count;
-/* The number of tokens in the token_stream */
-int tokens_in_stream;
-/* 1 if an error is encountered, 0 otherwise */
-int error_encountered;
-/* Used to track the commencement of a session in BASH */
-int session_started = 0;
-/* Tracks how many functions deep parsing is */
-int parse_level;
+/* The context the calling thread is evaluating in */
+MP_THREAD_LOCAL MathContext* ctx;
+/* The context Bash evaluates expressions in, made on first use */
+static MathContext* shell_context;
+
+/*
+ * Returns a new context, with no identifiers or watched formulas, that
+ * prints results to stdout and errors to stderr, or NULL if it could not
+ * be allocated.
+ */
+MathContext* make_context()
+{
+    MathContext* context = calloc(1, sizeof(MathContext));
+    if (context == NULL)
+        return NULL;
+    context->token_stream = calloc(MAX_TOKENS, sizeof(Token));
+    context->identifiers = calloc(MAX_TOKENS, sizeof(Token*));
+    if (context->token_stream == NULL || context->identifiers == NULL) {
+        free(context->token_stream);
+        free(context->identifiers);
+        free(context);
+        return NULL;
+    }
+    reset_format(&context->output_format);
+    context->out = stdout;
+    context->err = stderr;
+    return context;
+}
+
+/*
+ * Frees a context and everything within it, including the values of its
+ * identifiers.
+ */
+void free_context(MathContext* context)
+{
+    MathContext* saved = use_context(context);
+
+    for (int i = 0; i < ctx->identifier_count; i++) {
+        free_value(&ctx->identifiers[i]->value);
+        free(ctx->identifiers[i]->lvalue);
+        free(ctx->identifiers[i]);
+    }
+    free(ctx->identifiers);
+    free(ctx->token_stream);
+    free_watches();
+    for (int base = 0; base <= MAX_BASE; base++)
+        free(ctx->digit_pairs[base]);
+
+    use_context(saved == context ? NULL : saved);
+    free(context);
+}
+
+/*
+ * Makes a context the one the calling thread evaluates in. A context must
+ * only be used by one thread at a time.
+ *
+ * returns: The context the thread was previously using
+ */
+MathContext* use_context(MathContext* context)
+{
+    MathContext* previous = ctx;
+    ctx = context;
+    return previous;
+}
 
 /*
  * Returns a string comprising of the LValue of an identifier token
@@ -42,10 +80,10 @@ char* get_identifier_token(char ch)
     int idx = 0;
     int encountered_whitespace = 0;
 
-    while (nextCh != 0 && isalpha(nextCh) && !encountered_whitespace
+    while (ctx->nextCh != 0 && isalpha(ctx->nextCh) && !encountered_whitespace
             && idx < MAX_IDENT_LENGTH) {
-        identifier[idx++] = nextCh;
-        nextCh = get_next_char_report_whitespace(&encountered_whitespace);
+        identifier[idx++] = ctx->nextCh;
+        ctx->nextCh = get_next_char_report_whitespace(&encountered_whitespace);
     }
     identifier[idx++] = '\0';
 
@@ -53,89 +91,215 @@ char* get_identifier_token(char ch)
 }
 
 /*
- * The entry point for mathematical expression evaluation. scans, lexes and
- * parses the input expression before evaluation the result
+ * Scans an input expression into the token stream of the current context,
+ * ready for evaluation. Errors in the expression are reported to the
+ * context's error stream.
  *
- * expression: a string comprising of the input expression to be processed
+ * expression: a string comprising of the input expression to be scanned
+ *
+ * returns: The number of tokens scanned (including EOF), or -1 if the
+ *          expression could not be scanned.
  */
-void handle_expression(char* expression)
+int scan_expression(const char* expression)
 {
     /* Reset globals */
-    memset(buffer, 0, BUFF_SZ);
-    buff_idx = 0;
-    buff_sz = strlen(expression);
+    memset(ctx->buffer, 0, BUFF_SZ);
+    ctx->buff_idx = 0;
+    ctx->buff_sz = strlen(expression);
     /* 
      * One less due to initial call to get_next_char() 
      * below, which modifies this variable 
      */
-    current_column = -1;
-    error_encountered = 0;
-    parse_level = 0;
+    ctx->current_column = -1;
+    ctx->error_encountered = 0;
+    ctx->parse_level = 0;
+    ctx->evaluation_count++;
+    ctx->result_format = ctx->output_format;
 
-    if (buff_sz >= BUFF_SZ) {
+    if (ctx->buff_sz >= BUFF_SZ) {
         syntax_error(NULL, INP_TOO_LONG);
-        return ;
+        return -1;
     }
 
-    memcpy(buffer, expression, strlen(expression));
-    free(expression);
+    memcpy(ctx->buffer, expression, ctx->buff_sz);
     /* Initialise next char */
-    nextCh = get_next_char();
+    ctx->nextCh = get_next_char();
 
-    /* Constructs the token stream */
-    token_stream = malloc(sizeof(Token) * MAX_TOKENS);
-    memset(token_stream, 0, sizeof(Token) * MAX_TOKENS);
-    if (!session_started) {
-        identifiers = malloc(sizeof(Token) * MAX_TOKENS);
-        memset(identifiers, 0, sizeof(Token) * MAX_TOKENS);
-        identifier_count = 0;
-        session_started = 1;
-    }
+    memset(ctx->token_stream, 0, sizeof(Token) * MAX_TOKENS);
 
-    tokens_in_stream = 0;
-    token_stream_idx = 0;
+    /* Constructs the token stream */
+    ctx->tokens_in_stream = 0;
+    ctx->token_stream_idx = 0;
     Token* current_token;
 
     while ((current_token = next())) {
-        token_stream[tokens_in_stream++] = *current_token;
+        if (ctx->tokens_in_stream == MAX_TOKENS) {
+            /* Keywords and builtins point at static names */
+            if (current_token->type == IDENTIFIER)
+                free(current_token->lvalue);
+            free(current_token);
+            syntax_error(NULL, TOO_MANY_TOKENS);
+            return -1;
+        }
+        Token* token = &ctx->token_stream[ctx->tokens_in_stream++];
+        *token = *current_token;
         /* Is this token also an identifier token? */
-        if (current_token->type == IDENTIFIER)
-            add_identifier(current_token);
+        if (current_token->type == IDENTIFIER) {
+            Token* identifier = add_identifier(current_token);
+            if (identifier != current_token) {
+                /* Already in use, so share the identifier's name */
+                token->lvalue = identifier->lvalue;
+                free(current_token->lvalue);
+                free(current_token);
+            }
+        } else
+            free(current_token);
 
-        if (current_token->type == ENDOFFILE)
+        if (token->type == ENDOFFILE)
             /* The first and only token was EOF */
-            if (tokens_in_stream == 1) {
-                syntax_error(current_token, UNEXPECTED_EOF);
-                return ;
+            if (ctx->tokens_in_stream == 1) {
+                syntax_error(token, UNEXPECTED_EOF);
+                return -1;
             } else
                 break;
 
-        if (current_token->type == ILLEGAL) {
-            syntax_error(current_token, BAD_SYNTAX);
-            return;
+        if (token->type == ILLEGAL) {
+            syntax_error(token, BAD_SYNTAX);
+            return -1;
         }
     }
     
     DEBUG_PRINT("=========================\n");
     DEBUG_PRINT("Token stream generated...\n");
     DEBUG_PRINT("=========================\n");
+    return ctx->tokens_in_stream;
+}
+
+/*
+ * Evaluates the scanned token stream. Evaluation may be repeated without
+ * scanning the expression again.
+ *
+ * returns: The value of the expression, which is only meaningful if
+ *          no error was encountered and the whole stream was parsed.
+ */
+Value evaluate_expression()
+{
+    ctx->token_stream_idx = 0;
+    ctx->error_encountered = 0;
+    ctx->parse_level = 0;
+
+    Value answer = parse_block();
+    DEBUG_PRINT("There are %d identifiers\n", ctx->identifier_count);
+
+    if (!ctx->error_encountered
+            && ctx->token_stream_idx != ctx->tokens_in_stream - 1)
+        unknown_seq_error();
+    return answer;
+}
+
+/*
+ * Scans an input expression then carries out the statement it holds: a
+ * help, format or watch listing statement, or otherwise the evaluation of
+ * the expression.
+ *
+ * expression: a string comprising of the input expression to be processed
+ *     answer: Set to the value of the expression, if it has one
+ *
+ * returns: 1 if answer was set, 0 if the statement has no value, or -1 if
+ *          an error was encountered
+ */
+static int run_statement(const char* expression, Value* answer)
+{
+    if (scan_expression(expression) < 0)
+        return -1;
 
     if (is_match(KW_HELP)) {
         match(KW_HELP);
         display_help();
-        return ;
+        return 0;
     }
 
-    long long answer = parse_block();
-    DEBUG_PRINT("There are %d identifiers\n", identifier_count);
+    if (is_match(KW_WATCH) && peek_next_token().type == ENDOFFILE) {
+        list_watches();
+        return 0;
+    }
 
-    if (error_encountered)
-        return ;
-    else if (token_stream_idx != tokens_in_stream - 1)
-        unknown_seq_error();
-    else
+    if (is_match(KW_FORMAT)) {
+        parse_format();
+        if (ctx->error_encountered)
+            return -1;
+        if (ctx->token_stream_idx != ctx->tokens_in_stream - 1) {
+            unknown_seq_error();
+            return -1;
+        }
+        return 0;
+    }
+
+    *answer = evaluate_expression();
+    if (!ctx->error_encountered
+            && ctx->token_stream_idx == ctx->tokens_in_stream - 1)
+        return 1;
+    free_value(answer);
+    return -1;
+}
+
+/*
+ * Evaluates an input expression within a context, as Bash does, except
+ * that the value of the expression is returned rather than printed.
+ * Watched formulas recomputed as a result are printed to the context's
+ * output stream.
+ *
+ *    context: The context to evaluate the expression in
+ * expression: a string comprising of the input expression to be processed
+ *     result: Set to the value of the expression, if it has one. The
+ *             caller frees the value with free_value().
+ *
+ * returns: 1 if result was set, 0 if the statement has no value (e.g.
+ *          format), or -1 if an error was encountered
+ */
+int evaluate_string(MathContext* context, const char* expression,
+        Value* result)
+{
+    MathContext* saved = use_context(context);
+
+    int status = run_statement(expression, result);
+    if (status > 0)
+        *result = own_value(*result);
+    /* Recompute watched formulas reading anything just assigned */
+    if (!ctx->error_encountered)
+        propagate_change();
+
+    use_context(saved);
+    return status;
+}
+
+/*
+ * The entry point for mathematical expression evaluation. scans, lexes and
+ * parses the input expression before evaluation the result
+ *
+ * expression: a string comprising of the input expression to be processed
+ */
+void handle_expression(char* expression)
+{
+    if (shell_context == NULL)
+        shell_context = make_context();
+    if (shell_context == NULL) {
+        fprintf(stderr, "Error: Not enough memory for a context\n");
+        free(expression);
+        return;
+    }
+    use_context(shell_context);
+
+    Value answer;
+    if (run_statement(expression, &answer) > 0) {
         /* Print the answer */
-        printf("%lld\n", answer);
+        print_value(answer, &ctx->result_format);
+        free_value(&answer);
+    }
+    free(expression);
+    /* Recompute watched formulas reading anything just assigned */
+    if (!ctx->error_encountered)
+        propagate_change();
 }
 
 /*
@@ -144,19 +308,24 @@ void handle_expression(char* expression)
  *
  * token: The token that was identified as an identifier which should be
  *        added to the list of identifiers
+ *
+ * returns: The identifier token of that name, which is token itself unless
+ *          the identifier was already in use.
  */
-void add_identifier(Token* token)
+Token* add_identifier(Token* token)
 {
-    for (int i = 0; i < identifier_count; i++) {
-        if (strcmp(identifiers[i]->lvalue, token->lvalue) == 0) {
+    for (int i = 0; i < ctx->identifier_count; i++) {
+        if (strcmp(ctx->identifiers[i]->lvalue, token->lvalue) == 0) {
             /* Identifier already in use - update col pos and return*/
-            identifiers[i]->col_pos = token->col_pos;
-            return ; 
+            ctx->identifiers[i]->col_pos = token->col_pos;
+            return ctx->identifiers[i];
         }
     }
     token->val = 0x80808080; /* Garage placeholder value */
+    token->value = make_scalar(0x80808080);
     token->lvalue_is_assigned = 0;
-    identifiers[identifier_count++] = token;
+    ctx->identifiers[ctx->identifier_count++] = token;
+    return token;
 }
 
 /*
@@ -170,9 +339,9 @@ void add_identifier(Token* token)
  */
 Token* get_identifier(char* lvalue)
 {
-    for (int i = 0; i < identifier_count; i++) {
-        if (strcmp(identifiers[i]->lvalue, lvalue) == 0)
-           return identifiers[i];
+    for (int i = 0; i < ctx->identifier_count; i++) {
+        if (strcmp(ctx->identifiers[i]->lvalue, lvalue) == 0)
+           return ctx->identifiers[i];
     }
     return NULL;
 }
@@ -182,15 +351,34 @@ Token* get_identifier(char* lvalue)
  */
 void display_help() 
 {
-    printf("Expressions can be input by starting a command with \neither: a number"
+    fprintf(ctx->out, "Expressions can be input by starting a command with \neither: a number"
         "or with the character '='\n\n");
-    printf("For example:\n$ =1+1\n$ 2\n\n");
-    printf("* Python-like EBNF Math grammar\n"
+    fprintf(ctx->out, "For example:\n$ =1+1\n$ 2\n\n");
+    fprintf(ctx->out, "Results are printed in decimal unless formatted otherwise:\n"
+        "$ =hex(255)        one result in hex (also oct(), bin(), base(x, b))\n"
+        "$ =format bin group 4 width 16 unsigned\n"
+        "                   every later result in grouped, padded binary\n"
+        "$ =format          back to plain decimal\n\n");
+    fprintf(ctx->out, "Number theory functions:\n"
+        "$ =isprime(97)     1 if prime (also element-wise on vectors)\n"
+        "$ =nextprime(100)  the next prime, 101\n"
+        "$ =factor(360)     [2, 2, 2, 3, 3, 5]\n"
+        "$ =primecount(1...1000000)\n"
+        "                   the number of primes in a range\n\n");
+    fprintf(ctx->out, "Watched formulas are recomputed when what they read changes:\n"
+        "$ =watch area = w * h\n"
+        "$ =w = 3           also prints the new value of area\n"
+        "$ =watch           lists the watched formulas\n\n");
+    fprintf(ctx->out, "* Python-like EBNF Math grammar\n"
      "*\n"
      "* --------- Lowest Precedence ---------\n"
-     "* Block        -> Assignment | Summation | Exp\n"
+     "* Block        -> Watch | Format | Assignment | Summation | Exp\n"
+     "* Watch        -> KW_WATCH LValue ASSIGN Exp\n"
+     "* Format       -> KW_FORMAT {FormatOption}\n"
+     "* FormatOption -> dec | hex | oct | bin | signed | unsigned\n"
+     "*                 | (base | group | width) Numeric\n"
      "* Assignment   -> LValue ASSIGN Exp\n"
-     "* Summation    -> KW_SUM LValue KW_OVER Subrange KW_IN Exp\n"
+     "* Summation    -> KW_SUM LValue KW_OVER Subrange KW_IN Exp | KW_SUM Exp\n"
      "* Subrange     -> Exp RANGE Exp\n"
      "* Exp          -> BitwiseOr EOF\n"
      "* BitwiseOr    -> BitwiseXor {OR BitwiseXor}\n"
@@ -201,6 +389,10 @@ void display_help()
      "* Term         -> Exponent {(TIMES | DIVIDE | MODULUS) Exponent}\n"
      "* Exponent     -> Factor [EXPONENTIAL Factor]\n"
      "* Factor       -> LPAREN Exp RPAREN | {(PLUS | MINUS)} Numeric | LValue\n"
+     "*                 | Vector | Builtin\n"
+     "* Builtin      -> BUILTIN LPAREN [Argument {COMMA Argument}] RPAREN\n"
+     "* Argument     -> Exp [RANGE Exp]\n"
+     "* Vector       -> LBRACKET [Exp (RANGE Exp | {COMMA Exp})] RBRACKET\n"
      "* Numeric      -> ['0x' | '0b' | '0'] NUMBER\n"
      "* LValue       -> IDENTIFIER\n"
      "* --------- Highest Precedence ---------\n");
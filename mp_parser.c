@@ -1,16 +1,17 @@
 #include "math_parser.h"
 
-extern int token_stream_idx;
-extern int error_encountered;
-extern Token* token_stream;
 
 /*
  * Python-like EBNF Math grammar
  *
  * --------- Lowest Precedence ---------
- * Block        -> Assignment | Summation | Exp
+ * Block        -> Watch | Format | Assignment | Summation | Exp
+ * Watch        -> KW_WATCH LValue ASSIGN Exp
+ * Format       -> KW_FORMAT {FormatOption}
+ * FormatOption -> dec | hex | oct | bin | signed | unsigned
+ *                 | (base | group | width) Numeric
  * Assignment   -> LValue ASSIGN Exp
- * Summation    -> KW_SUM LValue KW_OVER Subrange KW_IN Exp
+ * Summation    -> KW_SUM LValue KW_OVER Subrange KW_IN Exp | KW_SUM Exp
  * Subrange     -> Exp RANGE Exp
  * Exp          -> BitwiseOr EOF
  * BitwiseOr    -> BitwiseXor {OR BitwiseXor}
@@ -21,6 +22,10 @@ extern Token* token_stream;
  * Term         -> Exponent {(TIMES | DIVIDE | MODULUS) Exponent}
  * Exponent     -> Factor [EXPONENTIAL Factor]
  * Factor       -> LPAREN Exp RPAREN | {(PLUS | MINUS)} Numeric | LValue
+ *                 | Vector | Builtin
+ * Builtin      -> BUILTIN LPAREN [Argument {COMMA Argument}] RPAREN
+ * Argument     -> Exp [RANGE Exp]
+ * Vector       -> LBRACKET [Exp (RANGE Exp | {COMMA Exp})] RBRACKET
  * Numeric      -> ['0x' | '0b' | '0'] NUMBER       (get_numerical_value())
  * LValue       -> IDENTIFIER
  * --------- Highest Precedence ---------
@@ -29,67 +34,189 @@ extern Token* token_stream;
 /*
  * Rule: Block -> Assignment | Summation | Exp
  */
-long long parse_block() 
+Value parse_block() 
 {
     PARSE_ENTRY("Parsing Block\n");
-    long long value;
+    Value value;
     if (is_match(KW_SUM))
         value = parse_summation();
+    else if (is_match(KW_WATCH))
+        value = parse_watch();
     else if (is_match(IDENTIFIER) && peek_next_token().type == ASSIGN)
         value = parse_assignment();
     else
         value = parse_exp();
 
-    PARSE_ENTRY("Finished Block\n");
+    PARSE_EXIT("Finished Block\n");
     return value;
 }
 
+/*
+ * Rule: Format -> KW_FORMAT {FormatOption}
+ *
+ * Replaces the output format with the default (signed decimal) modified by
+ * each of the options in turn.
+ */
+void parse_format()
+{
+    PARSE_ENTRY("Parsing format\n");
+    Format format;
+    reset_format(&format);
+    match(KW_FORMAT);
+
+    /* Options are words, some of which are also built-in function names */
+    while (!ctx->error_encountered
+            && (is_match(IDENTIFIER) || is_match(BUILTIN))) {
+        Token option = peek_token();
+        match(option.type);
+
+        if (strcmp(option.lvalue, "dec") == 0)
+            format.base = 10;
+        else if (strcmp(option.lvalue, "hex") == 0)
+            format.base = 16;
+        else if (strcmp(option.lvalue, "oct") == 0)
+            format.base = 8;
+        else if (strcmp(option.lvalue, "bin") == 0)
+            format.base = 2;
+        else if (strcmp(option.lvalue, "signed") == 0)
+            format.is_unsigned = 0;
+        else if (strcmp(option.lvalue, "unsigned") == 0)
+            format.is_unsigned = 1;
+        else if (strcmp(option.lvalue, "base") == 0
+                || strcmp(option.lvalue, "group") == 0
+                || strcmp(option.lvalue, "width") == 0) {
+            int num_pos = peek_token().col_pos;
+            long long num = peek_token().val;
+            if (match(NUMERIC) == MATCH_ERR)
+                break;
+
+            if (option.lvalue[0] == 'b' && (num < 2 || num > MAX_BASE))
+                format_option_err(num_pos, "Base must be between 2 and 36");
+            else if (option.lvalue[0] == 'b')
+                format.base = num;
+            else if (num > MAX_FORMAT_WIDTH)
+                format_option_err(num_pos, "Group and width must be at most 128");
+            else if (option.lvalue[0] == 'g')
+                format.group = num;
+            else
+                format.width = num;
+        } else
+            format_option_err(option.col_pos, "Unknown format option");
+    }
+
+    if (!ctx->error_encountered)
+        ctx->output_format = format;
+    PARSE_EXIT("Finished format\n");
+}
+
+/*
+ * Rule: Watch -> KW_WATCH LValue ASSIGN Exp
+ */
+Value parse_watch()
+{
+    PARSE_ENTRY("Parsing watch\n");
+    match(KW_WATCH);
+    int target_pos = peek_token().col_pos;
+    if (!is_match(IDENTIFIER)) {
+        match(IDENTIFIER);
+        return make_scalar(0);
+    }
+    Token* target = parse_get_lvalue();
+    int to_shell = binds_shell_variable(target);
+    match(ASSIGN);
+
+    int exp_start = ctx->token_stream_idx;
+    Value watched_val = own_value(parse_exp());
+    /*
+     * Trailing tokens are reported by evaluate_expression(), and such a
+     * statement must neither watch the formula nor assign the target
+     */
+    if (ctx->error_encountered
+            || ctx->token_stream_idx != ctx->tokens_in_stream - 1
+            || !watch_formula(target->lvalue, exp_start, ctx->token_stream_idx,
+                target_pos)) {
+        free_value(&watched_val);
+        return watched_val;
+    }
+    PARSE_EXIT("Finished watch\n");
+    return assign_lvalue(target, watched_val, to_shell, target_pos);
+}
+
 /*
  * Rule: Assignment -> LValue ASSIGN Exp
  */
-long long parse_assignment()
+Value parse_assignment()
 {
     PARSE_ENTRY("Parsing assignment\n");
+    int target_pos = peek_token().col_pos;
     Token* target = parse_get_lvalue();
-    target->lvalue_is_assigned = 1;
+    int to_shell = binds_shell_variable(target);
+    if (!to_shell)
+        target->lvalue_is_assigned = 1;
     match(ASSIGN);
-    long long assigned_val = parse_exp();
-    target->val = assigned_val;
+    /* Copy before releasing the old value, in case it is borrowed from it */
+    Value assigned_val = own_value(parse_exp());
+    if (ctx->error_encountered) {
+        free_value(&assigned_val);
+        return assigned_val;
+    }
+    /* A plain assignment replaces any watched formula for the target */
+    unwatch(target->lvalue);
     PARSE_EXIT("Finished assignment\n");
-    return assigned_val;
+    return assign_lvalue(target, assigned_val, to_shell, target_pos);
 }
 
 /*
- * Rule: Summation -> KW_SUM LValue KW_OVER Subrange KW_IN Exp
+ * Rule: Summation -> KW_SUM LValue KW_OVER Subrange KW_IN Exp | KW_SUM Exp
  */
-long long parse_summation()
+Value parse_summation()
 {
     PARSE_ENTRY("Parsing summation\n");
     match(KW_SUM);
+
+    /* Sum the elements of a vector or range */
+    if (!(is_match(IDENTIFIER) && peek_next_token().type == KW_OVER)) {
+        Value elements = parse_exp();
+        long long sum = sum_value(elements);
+        free_value(&elements);
+        PARSE_EXIT("Finished summation\n");
+        return make_scalar(sum);
+    }
+
+    /*
+     * The summation variable is bound only while the sum is evaluated, so
+     * it neither changes the identifier's value nor shadows a shell
+     * variable afterwards, and no watched formula sees it change
+     */
     Token* target = parse_get_lvalue();
-    target->lvalue_is_assigned = 1;
-    long long acculumlator = 0;
+    Value saved_value = target->value;
+    int saved_assigned = target->lvalue_is_assigned;
     
     match(KW_OVER);
     // parse subrange here
     int lower_bound, upper_bound;
     parse_subrange(&lower_bound, &upper_bound);
+    int in_pos = peek_token().col_pos;
     match(KW_IN);
     
-    int parse_count_0 = token_stream_idx;
-    target->val = lower_bound;
-    acculumlator += parse_exp();
-    int parse_count_1 = token_stream_idx;
+    int parse_count_0 = ctx->token_stream_idx;
+    target->lvalue_is_assigned = 1;
+    target->value = make_scalar(lower_bound);
+    Value acculumlator = parse_exp();
+    int parse_count_1 = ctx->token_stream_idx;
 
     int tokens_in_exp = parse_count_1 - parse_count_0;
-    token_stream_idx -= tokens_in_exp;
+    ctx->token_stream_idx -= tokens_in_exp;
 
-    for (int i = lower_bound + 1; i <= upper_bound && !error_encountered; i++) {
-        target->val = i;
-        acculumlator += parse_exp();
-        token_stream_idx -= tokens_in_exp;
+    for (int i = lower_bound + 1;
+            i <= upper_bound && !ctx->error_encountered; i++) {
+        target->value = make_scalar(i);
+        acculumlator = binary_op(PLUS, acculumlator, parse_exp(), in_pos);
+        ctx->token_stream_idx -= tokens_in_exp;
     }
-    token_stream_idx += tokens_in_exp;
+    ctx->token_stream_idx += tokens_in_exp;
+    target->value = saved_value;
+    target->lvalue_is_assigned = saved_assigned;
 
     PARSE_EXIT("Finished summation\n");
     return acculumlator;
@@ -101,19 +228,146 @@ long long parse_summation()
 void parse_subrange(int* lower_bound, int* upper_bound)
 {
     PARSE_ENTRY("Parsing subrange\n");
-    *lower_bound = parse_exp();
+    int bound_pos = peek_token().col_pos;
+    *lower_bound = scalar_of(parse_exp(), bound_pos);
     match(RANGE);
-    *upper_bound = parse_exp();
+    bound_pos = peek_token().col_pos;
+    *upper_bound = scalar_of(parse_exp(), bound_pos);
     PARSE_EXIT("Finished subrange\n");
 }
 
+/*
+ * Rule: Builtin -> BUILTIN LPAREN [Argument {COMMA Argument}] RPAREN
+ *       Argument -> Exp [RANGE Exp]
+ *
+ * An argument a...b passes the range from a to b, as [a...b] would.
+ */
+Value parse_builtin()
+{
+    PARSE_ENTRY("Parsing builtin\n");
+    Token call = peek_token();
+    const Builtin* builtin = find_builtin(call.lvalue);
+    Value args[MAX_BUILTIN_ARGS];
+    int nargs = 0, given = 0;
+
+    match(BUILTIN);
+    int paren_pos = peek_token().col_pos;
+    match(LPAREN);
+    if (!is_match(RPAREN) && !ctx->error_encountered) {
+        do {
+            if (given++ > 0)
+                match(COMMA);
+            int arg_pos = peek_token().col_pos;
+            Value arg = parse_exp();
+            if (is_match(RANGE)) {
+                match(RANGE);
+                long long lo = scalar_of(arg, arg_pos);
+                int hi_pos = peek_token().col_pos;
+                arg = make_range(lo, scalar_of(parse_exp(), hi_pos), hi_pos);
+            }
+            /* Surplus arguments are only counted, for the error message */
+            if (nargs < MAX_BUILTIN_ARGS)
+                args[nargs++] = arg;
+            else
+                free_value(&arg);
+        } while (is_match(COMMA));
+    }
+    if (is_match(RPAREN))
+        match(RPAREN);
+    else
+        /* The opening LParen wasn't closed */
+        paren_error(RPAREN, paren_pos);
+
+    if (given < builtin->min_args || given > builtin->max_args)
+        builtin_args_err(call.col_pos, builtin, given);
+
+    if (ctx->error_encountered) {
+        for (int i = 0; i < nargs; i++)
+            free_value(&args[i]);
+        PARSE_EXIT("Finished builtin\n");
+        return make_scalar(0);
+    }
+    PARSE_EXIT("Finished builtin\n");
+    return builtin->fn(args, nargs, call.col_pos);
+}
+
+/*
+ * Resizes the element buffer of a vector literal being parsed. If there
+ * is not enough memory the buffer is freed and the vector becomes a scalar.
+ *
+ *   vector: The vector being parsed
+ * capacity: The number of elements the buffer must hold
+ *
+ * returns: 1 if the buffer was resized, 0 otherwise
+ */
+static int resize_elems(Value* vector, long long capacity)
+{
+    long long* elems = realloc(vector->elems, capacity * sizeof(long long));
+
+    if (elems == NULL) {
+        free_value(vector);
+        vector_alloc_err(capacity);
+        return 0;
+    }
+    vector->elems = elems;
+    return 1;
+}
+
+/*
+ * Rule: Vector -> LBRACKET [Exp (RANGE Exp | {COMMA Exp})] RBRACKET
+ */
+Value parse_vector()
+{
+    PARSE_ENTRY("Parsing vector\n");
+    int bracket_pos = peek_token().col_pos;
+    match(LBRACKET);
+    Value vector = make_vector(0);
+
+    if (!is_match(RBRACKET) && !ctx->error_encountered) {
+        int elem_pos = peek_token().col_pos;
+        long long elem = scalar_of(parse_exp(), elem_pos);
+
+        if (is_match(RANGE)) {
+            /* A range literal is only materialised once it is operated on */
+            match(RANGE);
+            elem_pos = peek_token().col_pos;
+            free_value(&vector);
+            vector = make_range(elem, scalar_of(parse_exp(), elem_pos),
+                elem_pos);
+        } else {
+            long long capacity = 8;
+            if (resize_elems(&vector, capacity))
+                vector.elems[vector.len++] = elem;
+            while (vector.type == VAL_VECTOR && is_match(COMMA)) {
+                match(COMMA);
+                elem_pos = peek_token().col_pos;
+                elem = scalar_of(parse_exp(), elem_pos);
+                if (vector.len == capacity) {
+                    capacity *= 2;
+                    if (!resize_elems(&vector, capacity))
+                        break;
+                }
+                vector.elems[vector.len++] = elem;
+            }
+        }
+    }
+
+    if (is_match(RBRACKET))
+        match(RBRACKET);
+    else
+        /* The opening LBracket wasn't closed */
+        paren_error(RBRACKET, bracket_pos);
+    PARSE_EXIT("Finished vector\n");
+    return vector;
+}
+
 /*
  * Rule: Exp -> BitwiseOr EOF
  */
-long long parse_exp()
+Value parse_exp()
 {
     PARSE_ENTRY("Parsing expression\n");
-    long long value = parse_bitwise_or();
+    Value value = parse_bitwise_or();
     PARSE_EXIT("Finished expression\n");
     return value;
 }
@@ -121,13 +375,14 @@ long long parse_exp()
 /*
  * Rule: BitwiseOr -> BitwiseXor {OR BitwiseXor}
  */
-long long parse_bitwise_or()
+Value parse_bitwise_or()
 {
     PARSE_ENTRY("Parsing bitwise or\n");
-    long long value = parse_bitwise_xor();
+    Value value = parse_bitwise_xor();
     while (is_match(BIT_OR)) {
+        int op_pos = peek_token().col_pos;
         match(BIT_OR);
-        value |= parse_bitwise_xor();
+        value = binary_op(BIT_OR, value, parse_bitwise_xor(), op_pos);
     }
     PARSE_EXIT("Finished bitwise or\n");
     return value;
@@ -136,13 +391,14 @@ long long parse_bitwise_or()
 /*
  * Rule: BitwiseXor -> BitwiseAnd {XOR BitwiseAnd}
  */
-long long parse_bitwise_xor() 
+Value parse_bitwise_xor() 
 {
     PARSE_ENTRY("Parsing bitwise xor\n");
-    long long value = parse_bitwise_and();
+    Value value = parse_bitwise_and();
     while (is_match(BIT_XOR)) {
+        int op_pos = peek_token().col_pos;
         match(BIT_XOR);
-        value ^= parse_bitwise_and();
+        value = binary_op(BIT_XOR, value, parse_bitwise_and(), op_pos);
     }
     PARSE_EXIT("Finished bitwise xor\n");
     return value;
@@ -151,13 +407,14 @@ long long parse_bitwise_xor()
 /*
  * Rule: BitwiseAnd -> Bitshift {AND Bitshift}
  */
-long long parse_bitwise_and() 
+Value parse_bitwise_and() 
 {
     PARSE_ENTRY("Parsing bitwise and\n");
-    long long value = parse_bitshift();
+    Value value = parse_bitshift();
     while (is_match(BIT_AND)) {
+        int op_pos = peek_token().col_pos;
         match(BIT_AND);
-        value &= parse_bitshift();
+        value = binary_op(BIT_AND, value, parse_bitshift(), op_pos);
     }
     PARSE_EXIT("Finished bitwise and\n");
     return value;
@@ -166,19 +423,15 @@ long long parse_bitwise_and()
 /*
  * Rule: Bitshift -> Arith {(LSHIFT | RSHIFT) Arith}
  */
-long long parse_bitshift() 
+Value parse_bitshift() 
 {
     PARSE_ENTRY("Parsing bit shift\n");
-    long long value = parse_arith();
+    Value value = parse_arith();
     while (is_match(LSHIFT) || is_match(RSHIFT)) {
-        if (is_match(LSHIFT)) {
-            match(LSHIFT);
-            value <<= parse_arith();
-        }
-        else if (is_match(RSHIFT)) {
-            match(RSHIFT);
-            value >>= parse_arith();
-        }
+        Terminal op = peek_token().type;
+        int op_pos = peek_token().col_pos;
+        match(op);
+        value = binary_op(op, value, parse_arith(), op_pos);
     }
     PARSE_EXIT("Finished bit shift\n");
     return value;
@@ -187,27 +440,25 @@ long long parse_bitshift()
 /*
  * Rule: Arith -> [PLUS | MINUS] Term {(PLUS | MINUS) Term}
  */
-long long parse_arith() 
+Value parse_arith() 
 {
     PARSE_ENTRY("Parsing arith\n");
-    int sign = 1;
-    long long value;
+    int negate = 0;
+    Value value;
     if (is_match(PLUS))
         match(PLUS); /* Value already positive */
     else if (is_match(MINUS)) {
         match(MINUS);
-        sign = -1;
+        negate = 1;
     }
-    value = sign * parse_term();
+    value = parse_term();
+    if (negate)
+        value = negate_value(value);
     while (is_match(PLUS) || is_match(MINUS)) {
-        if (is_match(PLUS)) {
-            match(PLUS);
-            value += parse_term();
-        }
-        else if (is_match(MINUS)) {
-            match(MINUS);
-            value -= parse_term();
-        }
+        Terminal op = peek_token().type;
+        int op_pos = peek_token().col_pos;
+        match(op);
+        value = binary_op(op, value, parse_term(), op_pos);
     }
     PARSE_EXIT("Finished arith\n");
     return value;
@@ -216,32 +467,16 @@ long long parse_arith()
 /*
  * Rule: Term -> Exponent {(MULTIPLY | DIVIDE | MODULUS) Exponent}
  */
-long long parse_term() 
+Value parse_term() 
 {
     PARSE_ENTRY("Parsing term\n");
-    long long value = parse_exponent();
+    Value value = parse_exponent();
     while (is_match(MULTIPLY) || is_match(DIVIDE) || is_match(MODULUS)) {
-        if (is_match(MULTIPLY)) {
-            match(MULTIPLY);
-            value *= parse_exponent();
-        }
-        else if (is_match(DIVIDE)) {
-            match(DIVIDE);
-            long long res = parse_exponent();
-            if (res == 0)
-                div_by_zero_error(DIVIDE);
-            else
-                value /= res;
-        }
-        else if (is_match(MODULUS)) {
-            match(MODULUS);
-
-            long long res = parse_exponent();
-            if (res == 0)
-                div_by_zero_error(MODULUS);
-            else
-                value %= res;
-        }
+        /* binary_op() reports division and modulus by zero */
+        Terminal op = peek_token().type;
+        int op_pos = peek_token().col_pos;
+        match(op);
+        value = binary_op(op, value, parse_exponent(), op_pos);
     }
     PARSE_EXIT("Finished term\n");
     return value;
@@ -250,16 +485,14 @@ long long parse_term()
 /*
  * Rule: Exponent -> Factor [EXPONENTIAL Factor]
  */
-long long parse_exponent() 
+Value parse_exponent() 
 {
     PARSE_ENTRY("Parsing exponent\n");
-    long long value = parse_factor();
+    Value value = parse_factor();
     if (is_match(EXPONENTIATE)) {
+        int op_pos = peek_token().col_pos;
         match(EXPONENTIATE);
-        /* TODO: linking math library so we can use powl() from math.h */
-        int bound = parse_factor();
-        for (int i = 0; i < bound; i++)
-            value *= value;
+        value = binary_op(EXPONENTIATE, value, parse_factor(), op_pos);
     }
     PARSE_EXIT("Finished exponent\n");
     return value;
@@ -267,11 +500,12 @@ long long parse_exponent()
 
 /*
  * Rule: Factor -> LPAREN Exp RPAREN | {(MINUS | PLUS)} NUMBER | LValue
+ *                 | Vector
  */
-long long parse_factor()
+Value parse_factor()
 {
     PARSE_ENTRY("Parsing factor\n");
-    long long value = 0xBEEF; /* garbage placeholder */
+    Value value = make_scalar(0xBEEF); /* garbage placeholder */
     if (is_match(LPAREN)) {
         int paren_pos = peek_token().col_pos;
         match(LPAREN);
@@ -288,16 +522,25 @@ long long parse_factor()
          * If the token directly before this RParen is an LParen,
          * then it's just empty parentheses 
          */
-        if (peek_last_token().type == LPAREN && token_stream_idx > 0)
-            return 0;
+        if (peek_last_token().type == LPAREN && ctx->token_stream_idx > 0)
+            return make_scalar(0);
         int paren_pos = peek_token().col_pos;
         paren_error(LPAREN, paren_pos);
+    } else if (is_match(LBRACKET)) {
+        value = parse_vector();
+    } else if (is_match(BUILTIN)) {
+        value = parse_builtin();
+    } else if (is_match(RBRACKET)) {
+        int bracket_pos = peek_token().col_pos;
+        paren_error(LBRACKET, bracket_pos);
     } else if (is_match(IDENTIFIER)) {
+        int lvalue_pos = peek_token().col_pos;
         Token* parsed_lvalue = parse_get_lvalue();
-        if (!parsed_lvalue->lvalue_is_assigned)
+        if (parsed_lvalue->lvalue_is_assigned)
+            value = borrow_value(parsed_lvalue->value);
+        else if (!shell_variable_value(parsed_lvalue->lvalue, &value,
+                    lvalue_pos))
             unassigned_lvalue_err(*parsed_lvalue);
-        else
-            value = parsed_lvalue->val;
     } else {
         /* MUST be a number (optionally preceded by a sign) */
         int sign = 1;
@@ -310,7 +553,7 @@ long long parse_factor()
             }
         }
 
-        value = sign * peek_token().val; /* Cheating a bit... */
+        value = make_scalar(sign * peek_token().val); /* Cheating a bit... */
         match(NUMERIC);
     }
     PARSE_EXIT("Finished factor\n");
@@ -324,15 +567,47 @@ Token* parse_get_lvalue()
 {
     PARSE_ENTRY("Parsing LValue\n");
 
-    char* target_lvalue = malloc(MAX_IDENT_LENGTH * sizeof(char));
-    memset(target_lvalue, 0, sizeof(char) * MAX_IDENT_LENGTH);
     /* Get the readable name of the current lvalue */
-    strcpy(target_lvalue, peek_token().lvalue);
+    char* target_lvalue = peek_token().lvalue;
     match(IDENTIFIER);
     PARSE_EXIT("Finished LValue\n");
     return get_identifier(target_lvalue);
 }
 
+/*
+ * Returns 1 if assigning an LValue assigns the shell variable of the same
+ * name. Existing shell variables are assigned unless shadowed by an
+ * identifier already assigned within BashMath.
+ */
+int binds_shell_variable(Token* target)
+{
+    return !target->lvalue_is_assigned
+        && shell_variable_exists(target->lvalue);
+}
+
+/*
+ * Assigns a value to an LValue and records the change, so that watched
+ * formulas reading the LValue are recomputed.
+ *
+ *     target: The identifier token to assign
+ *      value: The value to assign, which must own its elements
+ *   to_shell: 1 to assign the shell variable of the same name
+ * target_pos: The position of target, used for error reporting
+ *
+ *    returns: A borrowed view of the assigned value
+ */
+Value assign_lvalue(Token* target, Value value, int to_shell, int target_pos)
+{
+    note_change(target->lvalue);
+    if (to_shell)
+        return shell_variable_assign(target->lvalue, value, target_pos);
+
+    target->lvalue_is_assigned = 1;
+    free_value(&target->value);
+    target->value = value;
+    return borrow_value(target->value);
+}
+
 /*
  * Compares the given terminal symbol to the current terminal symbol
  * in the token stream.
@@ -344,8 +619,8 @@ Token* parse_get_lvalue()
  */
 int is_match(Terminal terminal)
 {
-    return (!error_encountered
-        && token_stream[token_stream_idx].type == terminal);
+    return (!ctx->error_encountered
+        && ctx->token_stream[ctx->token_stream_idx].type == terminal);
 }
 
 /*
@@ -366,7 +641,7 @@ int match(Terminal expected)
     if (current_token.type == expected) {
         LEVEL_PRINT("Matched: %s\n", get_token_name(expected));
         /* Consider the current token matched and move on */
-        return token_stream_idx++;
+        return ctx->token_stream_idx++;
     }
 
     return match_error(current_token, expected);
@@ -380,7 +655,7 @@ int match(Terminal expected)
  */
 Token peek_token()
 {
-    return token_stream[token_stream_idx];
+    return ctx->token_stream[ctx->token_stream_idx];
 }
 
 /*
@@ -391,7 +666,7 @@ Token peek_token()
  */
 Token peek_next_token()
 {
-    return token_stream[token_stream_idx + 1];
+    return ctx->token_stream[ctx->token_stream_idx + 1];
 }
 
 /*
@@ -402,5 +677,5 @@ Token peek_next_token()
  */
 Token peek_last_token()
 {
-    return token_stream[token_stream_idx - 1];
+    return ctx->token_stream[ctx->token_stream_idx - 1];
 }
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "math_parser.h"
+
+/*
+ * Primality testing, factorisation and prime counting for the number
+ * theory built-in functions.
+ */
+
+/* The bases that make Miller-Rabin deterministic below 2^64 */
+static const unsigned long long mr_bases[] =
+    { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+#define MR_BASES (sizeof(mr_bases) / sizeof(mr_bases[0]))
+
+/* Factors below this are found by trial division before Pollard rho */
+#define TRIAL_LIMIT 1000
+/* Pollard rho takes a gcd once per this many steps */
+#define RHO_BATCH 128
+
+/*
+ * The sieve crosses off one segment of SIEVE_WORDS 64 bit words at a time,
+ * sized to stay in the L1 cache. Each bit stands for an odd number.
+ */
+#define SIEVE_WORDS 4096
+#define SIEVE_BITS (SIEVE_WORDS * 64ULL)
+/* Ranges reaching beyond MAX_SIEVE_ROOT squared are tested number by number */
+#define MAX_SIEVE_ROOT (1ULL << 24)
+/* Testing number by number checks for an interrupt once per this many */
+#define INTERRUPT_INTERVAL 65536
+
+#if defined(__GNUC__)
+#define popcount64(x) __builtin_popcountll(x)
+#define ctz64(x) __builtin_ctzll(x)
+#else
+static int popcount64(unsigned long long x)
+{
+    int n = 0;
+    for (; x; x &= x - 1)
+        n++;
+    return n;
+}
+
+static int ctz64(unsigned long long x)
+{
+    int n = 0;
+    for (; (x & 1) == 0; x >>= 1)
+        n++;
+    return n;
+}
+#endif
+
+static unsigned long long mul_mod(unsigned long long a, unsigned long long b,
+        unsigned long long m)
+{
+#if defined(__SIZEOF_INT128__)
+    return (unsigned __int128)a * b % m;
+#else
+    /* Double and add, without overflowing 64 bits */
+    unsigned long long r = 0;
+    a %= m;
+    while (b) {
+        if (b & 1)
+            r = (r >= m - a) ? r - (m - a) : r + a;
+        a = (a >= m - a) ? a - (m - a) : a + a;
+        b >>= 1;
+    }
+    return r;
+#endif
+}
+
+static unsigned long long pow_mod(unsigned long long b, unsigned long long e,
+        unsigned long long m)
+{
+    unsigned long long r = 1;
+    b %= m;
+    while (e) {
+        if (e & 1)
+            r = mul_mod(r, b, m);
+        b = mul_mod(b, b, m);
+        e >>= 1;
+    }
+    return r;
+}
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    while (b) {
+        unsigned long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Returns the largest integer whose square is at most n
+ */
+static unsigned long long isqrt(unsigned long long n)
+{
+    if (n < 2)
+        return n;
+    /* Newton's method, starting above the root and descending to it */
+    unsigned long long r = n / 2 + 1, next = (r + n / r) / 2;
+    while (next < r) {
+        r = next;
+        next = (r + n / r) / 2;
+    }
+    return r;
+}
+
+/*
+ * Returns 1 if n is prime, 0 otherwise. Miller-Rabin with the first twelve
+ * primes as witnesses is exact for every 64 bit n.
+ */
+int is_prime(unsigned long long n)
+{
+    if (n < 2)
+        return 0;
+    for (size_t i = 0; i < MR_BASES; i++) {
+        if (n % mr_bases[i] == 0)
+            return n == mr_bases[i];
+    }
+
+    unsigned long long d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+
+    for (size_t i = 0; i < MR_BASES; i++) {
+        unsigned long long x = pow_mod(mr_bases[i], d, n);
+        if (x == 1 || x == n - 1)
+            continue;
+        int r;
+        for (r = 1; r < s; r++) {
+            x = mul_mod(x, x, n);
+            if (x == n - 1)
+                break;
+        }
+        if (r == s)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Returns the smallest prime greater than n, or 0 if there is none below
+ * limit.
+ */
+unsigned long long next_prime(unsigned long long n, unsigned long long limit)
+{
+    if (n < 2)
+        return 2;
+    /* Only odd candidates from here on */
+    for (n += (n & 1) ? 2 : 1; n < limit; n += 2) {
+        if (is_prime(n))
+            return n;
+    }
+    return 0;
+}
+
+/*
+ * Returns a non-trivial factor of an odd composite n using Brent's
+ * variant of Pollard's rho, multiplying RHO_BATCH differences together
+ * between gcds.
+ */
+static unsigned long long rho_factor(unsigned long long n)
+{
+    for (unsigned long long c = 1; ; c++) {
+        unsigned long long x = 2, y = 2, ys = 2, q = 1, g = 1;
+        unsigned long long r = 1;
+
+        while (g == 1) {
+            x = y;
+            for (unsigned long long i = 0; i < r; i++)
+                y = (mul_mod(y, y, n) + c) % n;
+            for (unsigned long long k = 0; k < r && g == 1; k += RHO_BATCH) {
+                ys = y;
+                unsigned long long batch = r - k;
+                if (batch > RHO_BATCH)
+                    batch = RHO_BATCH;
+                for (unsigned long long i = 0; i < batch; i++) {
+                    y = (mul_mod(y, y, n) + c) % n;
+                    q = mul_mod(q, x > y ? x - y : y - x, n);
+                }
+                g = gcd(q, n);
+            }
+            r *= 2;
+        }
+        if (g == n) {
+            /* The batch overshot, so retrace it one step at a time */
+            do {
+                ys = (mul_mod(ys, ys, n) + c) % n;
+                g = gcd(x > ys ? x - ys : ys - x, n);
+            } while (g == 1);
+        }
+        if (g != n)
+            return g;
+        /* This c cycled without finding a factor, try the next */
+    }
+}
+
+static void factor_into(unsigned long long n, unsigned long long* factors,
+        int* count)
+{
+    if (n == 1)
+        return;
+    if (is_prime(n)) {
+        factors[(*count)++] = n;
+        return;
+    }
+    unsigned long long d = rho_factor(n);
+    factor_into(d, factors, count);
+    factor_into(n / d, factors, count);
+}
+
+/*
+ * Finds the prime factors of n, repeated by multiplicity.
+ *
+ *       n: The number to factor, at least 1
+ * factors: Receives the factors in ascending order; 64 is always enough
+ *
+ * returns: The number of factors
+ */
+int factorise(unsigned long long n, unsigned long long* factors)
+{
+    int count = 0;
+
+    for (unsigned long long p = 2; p < TRIAL_LIMIT && p * p <= n;
+            p += (p == 2) ? 1 : 2) {
+        while (n % p == 0) {
+            factors[count++] = p;
+            n /= p;
+        }
+    }
+    int large = count;
+    factor_into(n, factors, &count);
+
+    /* Rho finds the large factors in no particular order */
+    for (int i = large + 1; i < count; i++) {
+        unsigned long long f = factors[i];
+        int j = i;
+        for (; j > large && factors[j - 1] > f; j--)
+            factors[j] = factors[j - 1];
+        factors[j] = f;
+    }
+    return count;
+}
+
+/*
+ * Returns the odd primes up to limit, found with a plain sieve of
+ * Eratosthenes. The caller frees the array.
+ */
+static unsigned int* base_primes(unsigned long long limit, long* count)
+{
+    char* composite = calloc(limit / 2 + 1, 1);
+    unsigned int* primes = malloc((limit / 2 + 1) * sizeof(unsigned int));
+
+    *count = 0;
+    for (unsigned long long i = 3; i <= limit; i += 2) {
+        if (composite[i / 2])
+            continue;
+        primes[(*count)++] = i;
+        for (unsigned long long j = i * i; j <= limit; j += 2 * i)
+            composite[j / 2] = 1;
+    }
+    free(composite);
+    return primes;
+}
+
+/*
+ * Counts the primes within [lo, hi], optionally flagging each of them.
+ * Odd numbers are sieved one L1 sized segment at a time, crossing off the
+ * multiples of the odd primes up to sqrt(hi). Ranges whose square root is
+ * too large to sieve by are tested number by number instead. Either way
+ * the count stops early if the shell is interrupted.
+ *
+ *    lo: The first number of the range
+ *    hi: The last number of the range
+ * flags: If not NULL, flags[n - lo] is set to 1 if n is prime, 0 otherwise
+ *
+ * returns: The number of primes within the range, or -1 if interrupted
+ */
+long long count_primes(unsigned long long lo, unsigned long long hi,
+        long long* flags)
+{
+    long long count = 0;
+    unsigned long long first = lo;
+
+    if (hi < lo)
+        return 0;
+    if (flags != NULL)
+        memset(flags, 0, (hi - lo + 1) * sizeof(long long));
+    if (lo <= 2 && hi >= 2) {
+        count++;
+        if (flags != NULL)
+            flags[2 - first] = 1;
+    }
+    /* Only odd numbers from 3 are left to count */
+    lo = (lo < 3) ? 3 : (lo | 1);
+    if (hi < lo)
+        return count;
+
+    unsigned long long root = isqrt(hi);
+    if (root > MAX_SIEVE_ROOT) {
+        for (unsigned long long n = lo; n <= hi; n += 2) {
+            if ((n - lo) % (2 * INTERRUPT_INTERVAL) == 0 && shell_interrupted())
+                return -1;
+            if (is_prime(n)) {
+                count++;
+                if (flags != NULL)
+                    flags[n - first] = 1;
+            }
+        }
+        return count;
+    }
+
+    long nprimes;
+    unsigned int* primes = base_primes(root, &nprimes);
+    unsigned long long* words = malloc(SIEVE_WORDS * sizeof(*words));
+    /* Each base prime's next odd multiple, carried between segments */
+    unsigned long long* next = malloc((nprimes + 1) * sizeof(*next));
+
+    for (long i = 0; i < nprimes; i++) {
+        unsigned long long p = primes[i];
+        unsigned long long m = (lo + p - 1) / p * p;
+        if (m < p * p)
+            m = p * p;
+        if ((m & 1) == 0)
+            m += p;
+        next[i] = m;
+    }
+
+    for (unsigned long long start = lo; ; ) {
+        if (shell_interrupted()) {
+            count = -1;
+            break;
+        }
+        /* Bit i of the segment stands for start + 2i */
+        unsigned long long bits = (hi - start) / 2 + 1;
+        if (bits > SIEVE_BITS)
+            bits = SIEVE_BITS;
+        unsigned long long end = start + 2 * (bits - 1);
+        unsigned long long nwords = (bits + 63) / 64;
+
+        memset(words, 0, nwords * sizeof(unsigned long long));
+        for (long i = 0; i < nprimes; i++) {
+            /* Odd multiples of p are p bits apart */
+            unsigned long long p = primes[i];
+            unsigned long long bit = (next[i] - start) / 2;
+            for (; bit < bits; bit += p)
+                words[bit / 64] |= 1ULL << (bit % 64);
+            next[i] = start + 2 * bit;
+        }
+
+        /* Set bits are composite, so the clear ones are primes */
+        for (unsigned long long w = 0; w < nwords; w++) {
+            unsigned long long prime_bits = ~words[w];
+            if (w == nwords - 1 && bits % 64)
+                prime_bits &= (1ULL << (bits % 64)) - 1;
+            count += popcount64(prime_bits);
+            for (; flags != NULL && prime_bits; prime_bits &= prime_bits - 1)
+                flags[start + 2 * (w * 64 + ctz64(prime_bits)) - first] = 1;
+        }
+
+        if (hi - end < 2)
+            break;
+        start = end + 2;
+    }
+
+    free(next);
+    free(words);
+    free(primes);
+    return count;
+}
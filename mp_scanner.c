@@ -1,10 +1,20 @@
 #include "math_parser.h"
 
-extern char buffer[BUFF_SZ];
-extern int buff_idx;
-extern int buff_sz;
-extern int current_column;
-extern char nextCh;
+
+/* Identifiers that are scanned as keywords */
+static const struct {
+    const char* name;
+    Terminal type;
+    int starts_statement;   /* 1 if only a keyword as the first token */
+} keywords[] = {
+    { "sum", KW_SUM, 1 },
+    { "over", KW_OVER, 0 },
+    { "in", KW_IN, 0 },
+    { "help", KW_HELP, 1 },
+    { "format", KW_FORMAT, 1 },
+    { "watch", KW_WATCH, 1 },
+    { NULL, ILLEGAL, 0 }
+};
 
 /*
  * Returns the next tokenised item from the input expression.
@@ -19,32 +29,46 @@ Token* next()
     token->val = 0x80808080; /* Initially garbage value */
     token->col_pos = 0;  /* Default column position */
 
-    ch = nextCh;
+    ch = ctx->nextCh;
     
     if (ch == ENDOFFILE) {
         token->type = ENDOFFILE;
-        token->col_pos = current_column + 1;
+        token->col_pos = ctx->current_column + 1;
         return token;
     }
 
     if (isalpha(ch)) {
         token->type = IDENTIFIER;
-        token->col_pos = current_column + 1;
+        token->col_pos = ctx->current_column + 1;
         
         token->val = 0x80808080; /* Garbage place holder */
         token->lvalue = get_identifier_token(ch);
-        /* Extended keywords */
-        if (strcmp(token->lvalue, "sum") == 0)
-            token->type = KW_SUM;
-
-        if (strcmp(token->lvalue, "over") == 0)
-            token->type = KW_OVER;
-
-        if (strcmp(token->lvalue, "in") == 0)
-            token->type = KW_IN;
+        /*
+         * Extended keywords. Statement keywords and built-in function names
+         * are scanned as identifiers elsewhere, so that identifiers and
+         * shell variables of the same name can still be used.
+         */
+        const char* name = NULL;
+        for (int i = 0; keywords[i].name != NULL && name == NULL; i++) {
+            if (strcmp(token->lvalue, keywords[i].name) == 0
+                    && (!keywords[i].starts_statement
+                        || ctx->tokens_in_stream == 0)) {
+                token->type = keywords[i].type;
+                name = keywords[i].name;
+            }
+        }
 
-        if (strcmp(token->lvalue, "help") == 0)
-            token->type = KW_HELP;
+        /* A built-in function name is only a call when followed by '(' */
+        const Builtin* builtin = find_builtin(token->lvalue);
+        if (builtin != NULL && ctx->nextCh == '(') {
+            token->type = BUILTIN;
+            name = builtin->name;
+        }
+        if (name != NULL) {
+            /* Keywords and builtins need no copy of their name */
+            free(token->lvalue);
+            token->lvalue = (char*)name;
+        }
         DEBUG_PRINT("Token: %s, cp: %d, lv: %s\n", 
             get_token_name(token->type), token->col_pos, token->lvalue);
         return token;
@@ -52,22 +76,22 @@ Token* next()
 
     if (isdigit(ch)) {
         token->type = NUMERIC;
-        token->col_pos = current_column + 1;
+        token->col_pos = ctx->current_column + 1;
         DEBUG_PRINT("Token: %s, cp: %d\n", get_token_name(token->type),
             token->col_pos);
         token->val = get_numerical_value(ch);
         return token;
     }
 
-    nextCh = get_next_char();
+    ctx->nextCh = get_next_char();
 
     switch (ch) {
         case '/':
             token->type = DIVIDE;
             break;
         case '*':
-            if (nextCh == '*') {
-                nextCh = get_next_char();
+            if (ctx->nextCh == '*') {
+                ctx->nextCh = get_next_char();
                 token->type = EXPONENTIATE;
             }
             else
@@ -88,6 +112,15 @@ Token* next()
         case ')':
             token->type = RPAREN;
             break;
+        case '[':
+            token->type = LBRACKET;
+            break;
+        case ']':
+            token->type = RBRACKET;
+            break;
+        case ',':
+            token->type = COMMA;
+            break;
         case '^':
             token->type = BIT_XOR;
             break;
@@ -101,26 +134,26 @@ Token* next()
             token->type = ASSIGN;
             break;
         case '>':
-            if (nextCh == '>') {
-                nextCh = get_next_char();
+            if (ctx->nextCh == '>') {
+                ctx->nextCh = get_next_char();
                 token->type = RSHIFT;
             }
             else
                 token->type = ILLEGAL;
             break;
         case '<':
-            if (nextCh == '<') {
-                nextCh = get_next_char();
+            if (ctx->nextCh == '<') {
+                ctx->nextCh = get_next_char();
                 token->type = LSHIFT;
             }
             else
                 token->type = ILLEGAL;
             break;
         case '.':
-            if (nextCh == '.') {
-                nextCh = get_next_char();
-                if (nextCh == '.') {
-                    nextCh = get_next_char();
+            if (ctx->nextCh == '.') {
+                ctx->nextCh = get_next_char();
+                if (ctx->nextCh == '.') {
+                    ctx->nextCh = get_next_char();
                     token->type = RANGE;
                 } else
                     token->type = ILLEGAL;
@@ -131,7 +164,7 @@ Token* next()
         default:
             token->type = ILLEGAL;
     }
-    token->col_pos = current_column;
+    token->col_pos = ctx->current_column;
     DEBUG_PRINT("Token: %s, cp: %d\n", 
         get_token_name(token->type), token->col_pos);
     return token;
@@ -168,19 +201,19 @@ char get_next_char()
      * End of file once the buffer index goes
      * over the size of the buffer
      */
-    if (buff_idx == buff_sz + 1) {
-        current_column++;
+    if (ctx->buff_idx == ctx->buff_sz + 1) {
+        ctx->current_column++;
         return ENDOFFILE;
     }
 
     /* Skip over whitespace, if there is any */
-    while (buffer[buff_idx] == ' ') {
-        current_column++;
-        buff_idx++;
+    while (ctx->buffer[ctx->buff_idx] == ' ') {
+        ctx->current_column++;
+        ctx->buff_idx++;
     }
 
-    current_column++;
-    return buffer[buff_idx++];
+    ctx->current_column++;
+    return ctx->buffer[ctx->buff_idx++];
 }
 
 /*
@@ -200,20 +233,20 @@ char get_next_char_report_whitespace(int* skipped_whitespace)
      * End of file once the buffer index goes
      * over the size of the buffer
      */
-    if (buff_idx == buff_sz + 1) {
-        current_column++;
+    if (ctx->buff_idx == ctx->buff_sz + 1) {
+        ctx->current_column++;
         return ENDOFFILE;
     }
 
     /* Skip over whitespace, if there is any */
-    while (buffer[buff_idx] == ' ') {
+    while (ctx->buffer[ctx->buff_idx] == ' ') {
         *skipped_whitespace = 1;
-        current_column++;
-        buff_idx++;
+        ctx->current_column++;
+        ctx->buff_idx++;
     }
 
-    current_column++;
-    return buffer[buff_idx++];
+    ctx->current_column++;
+    return ctx->buffer[ctx->buff_idx++];
 }
 
 /*
@@ -235,17 +268,17 @@ long long get_numerical_value(char ch)
      * Ignore leading "0b" for binary numbers,
      * which strtol() doesn't handle for us
      */
-    nextCh = get_next_char();
-    if (ch == '0' && nextCh == 'b') {
+    ctx->nextCh = get_next_char();
+    if (ch == '0' && ctx->nextCh == 'b') {
         base = 2;
         ch = get_next_char();       /* Has number after 'b' */
-        nextCh = get_next_char();   /* Has number 2 after 'b' */
+        ctx->nextCh = get_next_char();   /* Has number 2 after 'b' */
     }
 
-    if (ch == '0' && (nextCh == 'x' || nextCh == 'X')) {
+    if (ch == '0' && (ctx->nextCh == 'x' || ctx->nextCh == 'X')) {
         base = 16;
         ch = get_next_char();
-        nextCh = get_next_char();
+        ctx->nextCh = get_next_char();
     }
 
     /* first num */
@@ -254,9 +287,10 @@ long long get_numerical_value(char ch)
      * Keep building the number until a character that
      * is not legal in a numeric or EOF is ecountered
      */
-    while (nextCh != 0 && legal_numeric(nextCh, base) && idx < BUFF_SZ) {
-        number[idx++] = nextCh;
-        nextCh = get_next_char();
+    while (ctx->nextCh != 0 && legal_numeric(ctx->nextCh, base)
+            && idx < BUFF_SZ) {
+        number[idx++] = ctx->nextCh;
+        ctx->nextCh = get_next_char();
     }
     errno = 0;
     value = strtoll(number, NULL, base);
@@ -0,0 +1,248 @@
+#if defined (SHELL)
+#include "config.h"
+#endif
+#include "math_parser.h"
+
+#if defined (SHELL)
+#include "shell.h"
+#include "arrayfunc.h"
+
+/*
+ * BashMath identifiers that have not been assigned within BashMath resolve
+ * to shell variables of the same name. Shell scalars become scalars and
+ * indexed arrays become vectors of their elements in index order.
+ */
+
+/* The number of shell arrays whose parsed elements are kept */
+#define ARRAY_CACHE_SZ 8
+
+/* The parsed elements of a shell array, valid while its serial matches */
+typedef struct {
+    ARRAY* array;
+    unsigned long serial;
+    unsigned long last_used;    /* evaluation_count when last read */
+    Value elems;
+} CachedArray;
+
+/*
+ * Shell variables belong to the shell rather than to any context, so one
+ * cache serves every context; the shell only evaluates one at a time.
+ */
+static CachedArray array_cache[ARRAY_CACHE_SZ];
+
+/*
+ * Returns the shell variable with the specified name, or NULL if there is
+ * no such variable or it has no value.
+ */
+static SHELL_VAR* lookup_shell_var(char* name)
+{
+    SHELL_VAR* var = find_variable(name);
+    if (var == NULL || invisible_p(var) || !var_isset(var))
+        return NULL;
+    return var;
+}
+
+/*
+ * Returns the cache slot to store the elements of an array in: the slot
+ * already holding that array, otherwise the least recently used slot.
+ * Slots read during the current evaluation may still be borrowed from, so
+ * are never chosen; NULL is returned if every slot is in use.
+ */
+static CachedArray* cache_slot(ARRAY* array)
+{
+    CachedArray* victim = NULL;
+    for (int i = 0; i < ARRAY_CACHE_SZ; i++) {
+        CachedArray* slot = &array_cache[i];
+        if (slot->array == array && slot->last_used != ctx->evaluation_count)
+            return slot;
+        if (slot->last_used == ctx->evaluation_count && slot->array != NULL)
+            continue;
+        if (victim == NULL || slot->last_used < victim->last_used)
+            victim = slot;
+    }
+    return victim;
+}
+
+/*
+ * Stores the elements of an array in the cache. The cache takes ownership
+ * of the element buffer.
+ *
+ * returns: A borrowed view of the cached elements, or the elements
+ *          themselves if there was no free cache slot.
+ */
+static Value cache_array(ARRAY* array, Value elems)
+{
+    CachedArray* slot = cache_slot(array);
+    if (slot == NULL)
+        return elems;
+
+    free_value(&slot->elems);
+    slot->array = array;
+    slot->serial = array_serial(array);
+    slot->last_used = ctx->evaluation_count;
+    slot->elems = elems;
+    return borrow_value(slot->elems);
+}
+
+/*
+ * Returns the elements of an indexed shell array as a vector, parsing the
+ * element strings only if the array changed since they were last parsed.
+ */
+static Value shell_array_elements(SHELL_VAR* var, int col_pos)
+{
+    ARRAY* array = array_cell(var);
+
+    for (int i = 0; i < ARRAY_CACHE_SZ; i++) {
+        CachedArray* slot = &array_cache[i];
+        if (slot->array == array && slot->serial == array_serial(array)) {
+            slot->last_used = ctx->evaluation_count;
+            return borrow_value(slot->elems);
+        }
+    }
+
+    Value elems = make_vector(array_num_elements(array));
+    if (elems.type != VAL_VECTOR)
+        return elems;
+
+    long long idx = 0;
+    for (ARRAY_ELEMENT* ae = element_forw(array_head(array));
+            ae != array_head(array); ae = element_forw(ae)) {
+        intmax_t n;
+        if (!legal_number(element_value(ae), &n)) {
+            shell_var_err(col_pos, var->name, "an element is not an integer");
+            free_value(&elems);
+            return make_scalar(0);
+        }
+        elems.elems[idx++] = n;
+    }
+    return cache_array(array, elems);
+}
+
+/*
+ * Returns 1 if a shell variable with the specified name exists and has a
+ * value, 0 otherwise.
+ */
+int shell_variable_exists(char* name)
+{
+    return lookup_shell_var(name) != NULL;
+}
+
+/*
+ * Retrieves the value of a shell variable for use in an expression.
+ *
+ *    name: The name of the shell variable
+ *   value: Set to the value of the shell variable. Array values are
+ *          borrowed and remain valid until the next expression.
+ * col_pos: The position of the identifier, used for error reporting
+ *
+ * returns: 1 if the shell variable exists, 0 otherwise
+ */
+int shell_variable_value(char* name, Value* value, int col_pos)
+{
+    SHELL_VAR* var = lookup_shell_var(name);
+    if (var == NULL)
+        return 0;
+
+    *value = make_scalar(0);
+    if (assoc_p(var))
+        shell_var_err(col_pos, name, "associative arrays are not supported");
+    else if (array_p(var))
+        *value = shell_array_elements(var, col_pos);
+    else {
+        intmax_t n;
+        if (legal_number(value_cell(var), &n))
+            *value = make_scalar(n);
+        else
+            shell_var_err(col_pos, name, "not an integer");
+    }
+    return 1;
+}
+
+/*
+ * Assigns a value to an existing shell variable. Scalars are assigned as
+ * with name=value, vectors and ranges replace the elements of an indexed
+ * array (converting a scalar variable to an array).
+ *
+ *    name: The name of the shell variable
+ *   value: The value to assign, which must own its elements
+ * col_pos: The position of the identifier, used for error reporting
+ *
+ * returns: A borrowed view of the assigned value
+ */
+Value shell_variable_assign(char* name, Value value, int col_pos)
+{
+    char num[INT_STRLEN_BOUND(intmax_t) + 1];
+    SHELL_VAR* var = lookup_shell_var(name);
+
+    if (var == NULL || readonly_p(var) || noassign_p(var)) {
+        shell_var_err(col_pos, name, "readonly variable");
+        free_value(&value);
+        return value;
+    }
+
+    if (value.type == VAL_SCALAR) {
+        bind_variable(name, inttostr(value.val, num, sizeof(num)), 0);
+        return value;
+    }
+
+    if (assoc_p(var)) {
+        shell_var_err(col_pos, name, "associative arrays are not supported");
+        free_value(&value);
+        return value;
+    }
+
+    materialise(&value);
+    if (value.type != VAL_VECTOR)
+        return value;
+
+    if (!array_p(var))
+        var = convert_var_to_array(var);
+    ARRAY* array = array_cell(var);
+    array_flush(array);
+    for (long long i = 0; i < value.len; i++)
+        array_insert(array, i, inttostr(value.elems[i], num, sizeof(num)));
+
+    /* The elements are already known, so the next read needn't parse them */
+    return cache_array(array, value);
+}
+
+/*
+ * Returns 1 if the shell has received SIGINT or a terminating signal since
+ * the current command began, so that long computations can stop early.
+ * The shell itself handles the signal once BashMath returns.
+ */
+int shell_interrupted()
+{
+    return interrupt_state || terminating_signal;
+}
+
+#else /* !SHELL */
+
+/*
+ * Built without the rest of Bash (see support/mpbench.c) there are no
+ * shell variables, so identifiers only ever refer to BashMath's own.
+ */
+
+int shell_variable_exists(char* name)
+{
+    return 0;
+}
+
+int shell_variable_value(char* name, Value* value, int col_pos)
+{
+    return 0;
+}
+
+Value shell_variable_assign(char* name, Value value, int col_pos)
+{
+    shell_var_err(col_pos, name, "no shell to assign");
+    free_value(&value);
+    return value;
+}
+
+int shell_interrupted()
+{
+    return 0;
+}
+
+#endif /* !SHELL */
@@ -0,0 +1,427 @@
+#include "math_parser.h"
+
+/*
+ * Element-wise kernels operate on SIMD_LANES elements per step using the
+ * compiler's generic vector extension, which lowers to whatever vector
+ * instructions the target provides. Other compilers only run the scalar
+ * tail loop of each kernel.
+ */
+#if defined(__GNUC__)
+#define SIMD_LANES 4
+typedef long long lanes_t __attribute__((vector_size(SIMD_LANES * sizeof(long long))));
+#endif
+
+/* Which operand of an element-wise operation is a broadcast scalar */
+typedef enum {
+    BCAST_NONE,
+    BCAST_LEFT,
+    BCAST_RIGHT
+} Broadcast;
+
+#if defined(SIMD_LANES)
+#define SIMD_LOOP(OP)                                                       \
+    lanes_t va = { 0 }, vb = { 0 }, vd;                                     \
+    if (bcast == BCAST_LEFT)                                                \
+        va = (lanes_t){ a[0], a[0], a[0], a[0] };                           \
+    if (bcast == BCAST_RIGHT)                                               \
+        vb = (lanes_t){ b[0], b[0], b[0], b[0] };                           \
+    for (; i + SIMD_LANES <= n; i += SIMD_LANES) {                          \
+        if (bcast != BCAST_LEFT)                                            \
+            memcpy(&va, a + i, sizeof(va));                                 \
+        if (bcast != BCAST_RIGHT)                                           \
+            memcpy(&vb, b + i, sizeof(vb));                                 \
+        vd = va OP vb;                                                      \
+        memcpy(dst + i, &vd, sizeof(vd));                                   \
+    }
+#else
+#define SIMD_LOOP(OP)
+#endif
+
+/*
+ * Defines an element-wise kernel computing dst[i] = a[i] OP b[i] over n
+ * elements, where either a or b may be a single broadcast scalar. dst may
+ * be the same buffer as a or b.
+ */
+#define DEFINE_KERNEL(name, OP)                                             \
+static void name(long long* dst, const long long* a, const long long* b,    \
+        long long n, Broadcast bcast)                                       \
+{                                                                           \
+    long long i = 0;                                                        \
+    SIMD_LOOP(OP)                                                           \
+    for (; i < n; i++)                                                      \
+        dst[i] = a[bcast == BCAST_LEFT ? 0 : i] OP                          \
+            b[bcast == BCAST_RIGHT ? 0 : i];                                \
+}
+
+DEFINE_KERNEL(kernel_add, +)
+DEFINE_KERNEL(kernel_sub, -)
+DEFINE_KERNEL(kernel_mul, *)
+DEFINE_KERNEL(kernel_and, &)
+DEFINE_KERNEL(kernel_or, |)
+DEFINE_KERNEL(kernel_xor, ^)
+DEFINE_KERNEL(kernel_lshift, <<)
+DEFINE_KERNEL(kernel_rshift, >>)
+
+/*
+ * Applies a binary operator to two scalars. The divisor of a DIVIDE or
+ * MODULUS must already be known to be non-zero.
+ */
+static long long scalar_kernel(Terminal op, long long a, long long b)
+{
+    switch (op) {
+        case PLUS:          return a + b;
+        case MINUS:         return a - b;
+        case MULTIPLY:      return a * b;
+        case DIVIDE:        return a / b;
+        case MODULUS:       return a % b;
+        case EXPONENTIATE:  return exponentiate(a, b);
+        case BIT_AND:       return a & b;
+        case BIT_OR:        return a | b;
+        case BIT_XOR:       return a ^ b;
+        case LSHIFT:        return a << b;
+        case RSHIFT:        return a >> b;
+        default:            return a;
+    }
+}
+
+/*
+ * Runs the kernel for the specified operator over n elements. Operators
+ * without a vector form (division, modulus, exponentiation) fall back to
+ * applying scalar_kernel() to each element.
+ */
+static void run_kernel(Terminal op, long long* dst, const long long* a,
+        const long long* b, long long n, Broadcast bcast)
+{
+    switch (op) {
+        case PLUS:      kernel_add(dst, a, b, n, bcast); return;
+        case MINUS:     kernel_sub(dst, a, b, n, bcast); return;
+        case MULTIPLY:  kernel_mul(dst, a, b, n, bcast); return;
+        case BIT_AND:   kernel_and(dst, a, b, n, bcast); return;
+        case BIT_OR:    kernel_or(dst, a, b, n, bcast); return;
+        case BIT_XOR:   kernel_xor(dst, a, b, n, bcast); return;
+        case LSHIFT:    kernel_lshift(dst, a, b, n, bcast); return;
+        case RSHIFT:    kernel_rshift(dst, a, b, n, bcast); return;
+        default:
+            for (long long i = 0; i < n; i++)
+                dst[i] = scalar_kernel(op, a[bcast == BCAST_LEFT ? 0 : i],
+                    b[bcast == BCAST_RIGHT ? 0 : i]);
+    }
+}
+
+/*
+ * Returns a scalar value
+ *
+ *     val: The value of the scalar
+ */
+Value make_scalar(long long val)
+{
+    Value value;
+    memset(&value, 0, sizeof(Value));
+    value.type = VAL_SCALAR;
+    value.val = val;
+    return value;
+}
+
+/*
+ * Returns a lazy range comprising each integer from lo to hi inclusive.
+ * The range is empty if hi is less than lo. Reports an error if the range
+ * has more elements than a long long can count.
+ *
+ *      lo: The first element of the range
+ *      hi: The last element of the range
+ *  hi_pos: The position of the expression that produced hi
+ */
+Value make_range(long long lo, long long hi, int hi_pos)
+{
+    Value value = make_scalar(0);
+    long long len = 0;
+
+    if (hi >= lo) {
+#if defined(__GNUC__)
+        int overflow = __builtin_sub_overflow(hi, lo, &len)
+            || __builtin_add_overflow(len, 1, &len);
+#else
+        int overflow = lo <= 0 && hi > LLONG_MAX - 1 + lo;
+        if (!overflow)
+            len = hi - lo + 1;
+#endif
+        if (overflow) {
+            range_overflow_err(hi_pos);
+            return value;
+        }
+    }
+    value.type = VAL_RANGE;
+    value.lo = lo;
+    value.len = len;
+    return value;
+}
+
+/*
+ * Returns a vector with an uninitialised buffer large enough for the
+ * specified number of elements.
+ *
+ *     len: The number of elements in the vector
+ */
+Value make_vector(long long len)
+{
+    Value value = make_scalar(0);
+    value.type = VAL_VECTOR;
+    value.len = len;
+    value.elems = malloc((len > 0 ? len : 1) * sizeof(long long));
+    if (value.elems == NULL) {
+        vector_alloc_err(len);
+        return make_scalar(0);
+    }
+    return value;
+}
+
+/*
+ * Returns a view of a value that shares its element buffer. The view
+ * must not outlive the value it was borrowed from.
+ */
+Value borrow_value(Value value)
+{
+    if (value.type == VAL_VECTOR)
+        value.borrowed = 1;
+    return value;
+}
+
+/*
+ * Returns a value that owns its element buffer, copying the elements of
+ * a borrowed vector.
+ */
+Value own_value(Value value)
+{
+    if (value.type != VAL_VECTOR || !value.borrowed)
+        return value;
+
+    Value copy = make_vector(value.len);
+    if (copy.type == VAL_VECTOR)
+        memcpy(copy.elems, value.elems, value.len * sizeof(long long));
+    return copy;
+}
+
+/*
+ * Releases the element buffer of an owned vector and resets the value to
+ * a scalar. Borrowed vectors, scalars and ranges own no buffer.
+ */
+void free_value(Value* value)
+{
+    if (value->type == VAL_VECTOR && !value->borrowed)
+        free(value->elems);
+    *value = make_scalar(0);
+}
+
+/*
+ * Converts a range into a vector holding each of its elements. Any other
+ * kind of value is left unchanged.
+ */
+void materialise(Value* value)
+{
+    if (value->type != VAL_RANGE)
+        return;
+
+    long long lo = value->lo;
+    *value = make_vector(value->len);
+    for (long long i = 0; i < value->len; i++)
+        value->elems[i] = lo + i;
+}
+
+/*
+ * Returns the value of a scalar. Reports an error if the value is a
+ * vector or range.
+ *
+ *   value: The value that is expected to be a scalar
+ * col_pos: The position of the expression that produced the value
+ */
+long long scalar_of(Value value, int col_pos)
+{
+    if (value.type == VAL_SCALAR)
+        return value.val;
+
+    free_value(&value);
+    scalar_expected_err(col_pos);
+    return 0;
+}
+
+/*
+ * Returns the sum of the elements of a value. Sums of ranges are computed
+ * in closed form without materialising the range.
+ */
+long long sum_value(Value value)
+{
+    if (value.type == VAL_SCALAR)
+        return value.val;
+
+    if (value.type == VAL_RANGE) {
+        long long n = value.len;
+        /* n(n-1)/2, halving whichever factor is even first */
+        long long tri = (n % 2 == 0) ? (n / 2) * (n - 1) : n * ((n - 1) / 2);
+        return n * value.lo + tri;
+    }
+
+    long long sum = 0, i = 0;
+#if defined(SIMD_LANES)
+    lanes_t acc = { 0, 0, 0, 0 }, v;
+    for (; i + SIMD_LANES <= value.len; i += SIMD_LANES) {
+        memcpy(&v, value.elems + i, sizeof(v));
+        acc += v;
+    }
+    for (int l = 0; l < SIMD_LANES; l++)
+        sum += acc[l];
+#endif
+    for (; i < value.len; i++)
+        sum += value.elems[i];
+    return sum;
+}
+
+/*
+ * Raises a value to a power
+ *
+ *   value: The base
+ *   bound: The exponent
+ */
+long long exponentiate(long long value, long long bound)
+{
+    /* TODO: linking math library so we can use powl() from math.h */
+    for (int i = 0; i < bound; i++)
+        value *= value;
+    return value;
+}
+
+/*
+ * Returns 1 if any element of a value is zero, 0 otherwise
+ */
+static int has_zero(Value value)
+{
+    if (value.type == VAL_SCALAR)
+        return value.val == 0;
+    for (long long i = 0; i < value.len; i++)
+        if (value.elems[i] == 0)
+            return 1;
+    return 0;
+}
+
+/*
+ * Applies a binary operator to two values. Scalars are broadcast against
+ * vectors and vectors are combined element-wise. Both operands are
+ * consumed; the result reuses an owned operand buffer where possible.
+ *
+ *      op: The operator to apply (e.g. PLUS, BIT_AND)
+ *    left: The left hand operand
+ *   right: The right hand operand
+ * col_pos: The position of the operator, used for error reporting
+ *
+ * returns: The result of the operation
+ */
+Value binary_op(Terminal op, Value left, Value right, int col_pos)
+{
+    if (ctx->error_encountered) {
+        free_value(&left);
+        free_value(&right);
+        return make_scalar(0);
+    }
+
+    if (left.type == VAL_SCALAR && right.type == VAL_SCALAR) {
+        if ((op == DIVIDE || op == MODULUS) && right.val == 0) {
+            div_by_zero_error(op);
+            return left;
+        }
+        return make_scalar(scalar_kernel(op, left.val, right.val));
+    }
+
+    materialise(&left);
+    materialise(&right);
+
+    if (left.type == VAL_VECTOR && right.type == VAL_VECTOR
+            && left.len != right.len) {
+        length_mismatch_err(col_pos, left.len, right.len);
+        free_value(&left);
+        free_value(&right);
+        return make_scalar(0);
+    }
+
+    if ((op == DIVIDE || op == MODULUS) && has_zero(right)) {
+        div_by_zero_error(op);
+        free_value(&left);
+        free_value(&right);
+        return make_scalar(0);
+    }
+
+    Broadcast bcast = BCAST_NONE;
+    long long len = left.len;
+    if (left.type == VAL_SCALAR) {
+        bcast = BCAST_LEFT;
+        len = right.len;
+    } else if (right.type == VAL_SCALAR)
+        bcast = BCAST_RIGHT;
+
+    Value result;
+    if (left.type == VAL_VECTOR && !left.borrowed)
+        result = left;
+    else if (right.type == VAL_VECTOR && !right.borrowed)
+        result = right;
+    else
+        result = make_vector(len);
+
+    if (result.type == VAL_VECTOR)
+        run_kernel(op, result.elems,
+            left.type == VAL_VECTOR ? left.elems : &left.val,
+            right.type == VAL_VECTOR ? right.elems : &right.val,
+            len, bcast);
+
+    if (left.elems != result.elems)
+        free_value(&left);
+    if (right.elems != result.elems)
+        free_value(&right);
+    return result;
+}
+
+/*
+ * Returns the negation of a value (element-wise for vectors)
+ */
+Value negate_value(Value value)
+{
+    if (value.type == VAL_SCALAR)
+        return make_scalar(-value.val);
+    return binary_op(MINUS, make_scalar(0), value, 0);
+}
+
+/*
+ * Returns the element at an index of a vector or range
+ */
+static long long element_at(Value value, long long idx)
+{
+    return (value.type == VAL_RANGE ? value.lo + idx : value.elems[idx]);
+}
+
+/*
+ * Prints a value to stdout. Vectors and ranges are printed as a bracketed
+ * list, with the middle elements elided if there are more than
+ * MAX_PRINT_ELEMS of them.
+ *
+ *  value: The value to print
+ * format: How to print each number
+ */
+void print_value(Value value, const Format* format)
+{
+    char num[FORMAT_BUFF_SZ];
+
+    if (value.type == VAL_SCALAR) {
+        fprintf(ctx->out, "%s\n", format_number(value.val, format, num));
+        return;
+    }
+
+    int elide = value.len > MAX_PRINT_ELEMS;
+    fprintf(ctx->out, "[");
+    for (long long i = 0; i < value.len; i++) {
+        if (elide && i == PRINT_EDGE_ELEMS) {
+            fprintf(ctx->out, "..., ");
+            i = value.len - PRINT_EDGE_ELEMS;
+        }
+        fprintf(ctx->out, "%s%s",
+            format_number(element_at(value, i), format, num),
+            i + 1 < value.len ? ", " : "");
+    }
+    fprintf(ctx->out, "]\n");
+}
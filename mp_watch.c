@@ -0,0 +1,285 @@
+#include "math_parser.h"
+
+/*
+ * Watched formulas are assignments that are kept and recomputed whenever
+ * an identifier they read is assigned, e.g. after '=watch area = w * h',
+ * assigning w or h recomputes area. Only formulas downstream of the
+ * assigned identifier are recomputed, in dependency order.
+ */
+
+struct Formula {
+    char* target;       /* The identifier the formula assigns */
+    char* text;         /* The input expression that defined the formula */
+    Token* tokens;      /* The formula's Exp, terminated by ENDOFFILE */
+    int tokens_in_exp;
+    char** inputs;      /* The identifiers the formula reads */
+    int input_count;
+    int visited;        /* Traversal mark, see collect_dependents() */
+};
+
+
+/*
+ * Returns the index of the formula assigning the specified identifier,
+ * or -1 if that identifier is not watched.
+ */
+static int find_formula(const char* target)
+{
+    for (int i = 0; i < ctx->formula_count; i++) {
+        if (strcmp(ctx->formulas[i]->target, target) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Returns 1 if a formula reads the specified identifier, 0 otherwise
+ */
+static int formula_reads(Formula* formula, const char* name)
+{
+    for (int i = 0; i < formula->input_count; i++) {
+        if (strcmp(formula->inputs[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static void free_formula(Formula* formula)
+{
+    free(formula->target);
+    free(formula->text);
+    free(formula->tokens);
+    for (int i = 0; i < formula->input_count; i++)
+        free(formula->inputs[i]);
+    free(formula->inputs);
+    free(formula);
+}
+
+/*
+ * Appends each formula downstream of an identifier to order, such that
+ * every formula appears before all of the formulas it reads from (i.e. in
+ * reverse dependency order). Visited formulas are marked; callers clear
+ * the marks afterwards.
+ *
+ *  name: The identifier whose dependents are collected
+ * order: Receives the dependent formulas
+ * count: The number of formulas in order
+ */
+static void collect_dependents(const char* name, Formula** order, int* count)
+{
+    for (int i = 0; i < ctx->formula_count; i++) {
+        Formula* formula = ctx->formulas[i];
+        if (formula->visited || !formula_reads(formula, name))
+            continue;
+        formula->visited = 1;
+        collect_dependents(formula->target, order, count);
+        /* Depth first, so this lands after everything downstream of it */
+        order[(*count)++] = formula;
+    }
+}
+
+/*
+ * Returns 1 if making target depend on the specified inputs would create a
+ * cycle, i.e. if target is an input or any input is downstream of target.
+ */
+static int creates_cycle(const char* target, char** inputs, int input_count)
+{
+    Formula** order = malloc((ctx->formula_count + 1) * sizeof(Formula*));
+    int count = 0, cycle = 0;
+
+    collect_dependents(target, order, &count);
+    for (int i = 0; i < input_count && !cycle; i++) {
+        if (strcmp(inputs[i], target) == 0)
+            cycle = 1;
+        for (int j = 0; j < count && !cycle; j++)
+            if (strcmp(order[j]->target, inputs[i]) == 0)
+                cycle = 1;
+    }
+    for (int i = 0; i < count; i++)
+        order[i]->visited = 0;
+    free(order);
+    return cycle;
+}
+
+/*
+ * Evaluates a formula's expression with its own token stream, restoring
+ * the token stream of the current expression afterwards.
+ */
+static Value evaluate_formula(Formula* formula)
+{
+    char saved_buffer[BUFF_SZ];
+    Token* saved_stream = ctx->token_stream;
+    int saved_idx = ctx->token_stream_idx;
+    int saved_tokens = ctx->tokens_in_stream;
+
+    /* Errors should point into the formula, not the current expression */
+    memcpy(saved_buffer, ctx->buffer, BUFF_SZ);
+    strcpy(ctx->buffer, formula->text);
+    ctx->token_stream = formula->tokens;
+    ctx->token_stream_idx = 0;
+    ctx->tokens_in_stream = formula->tokens_in_exp + 1;
+
+    Value value = own_value(parse_exp());
+
+    ctx->token_stream = saved_stream;
+    ctx->token_stream_idx = saved_idx;
+    ctx->tokens_in_stream = saved_tokens;
+    memcpy(ctx->buffer, saved_buffer, BUFF_SZ);
+    return value;
+}
+
+/*
+ * Watches a formula, replacing any formula previously assigning the same
+ * identifier. The formula is the Exp occupying the specified part of the
+ * current token stream.
+ *
+ *     target: The identifier the formula assigns
+ *  exp_start: The index of the first token of the formula's Exp
+ *    exp_end: The index one past the last token of the formula's Exp
+ * target_pos: The position of target, used for error reporting
+ *
+ * returns: 1 if the formula is watched, 0 if it would depend on itself
+ */
+int watch_formula(char* target, int exp_start, int exp_end, int target_pos)
+{
+    int tokens_in_exp = exp_end - exp_start;
+    char** inputs = malloc((tokens_in_exp + 1) * sizeof(char*));
+    int input_count = 0;
+
+    for (int i = exp_start; i < exp_end; i++) {
+        Token* token = &ctx->token_stream[i];
+        int seen = 0;
+        if (token->type != IDENTIFIER)
+            continue;
+        for (int j = 0; j < input_count && !seen; j++)
+            seen = (strcmp(inputs[j], token->lvalue) == 0);
+        if (!seen)
+            inputs[input_count++] = strdup(token->lvalue);
+    }
+
+    /* The old formula for target is being replaced, so ignore its edges */
+    int existing = find_formula(target);
+    Formula* replaced = NULL;
+    if (existing >= 0) {
+        replaced = ctx->formulas[existing];
+        ctx->formulas[existing] = ctx->formulas[--ctx->formula_count];
+    }
+
+    if (creates_cycle(target, inputs, input_count)) {
+        for (int i = 0; i < input_count; i++)
+            free(inputs[i]);
+        free(inputs);
+        if (replaced != NULL)
+            ctx->formulas[ctx->formula_count++] = replaced;
+        circular_dependency_err(target_pos, target);
+        return 0;
+    }
+    if (replaced != NULL)
+        free_formula(replaced);
+
+    Formula* formula = malloc(sizeof(Formula));
+    formula->target = strdup(target);
+    formula->text = strdup(ctx->buffer);
+    formula->tokens = malloc((tokens_in_exp + 1) * sizeof(Token));
+    memcpy(formula->tokens, ctx->token_stream + exp_start,
+        tokens_in_exp * sizeof(Token));
+    memset(&formula->tokens[tokens_in_exp], 0, sizeof(Token));
+    formula->tokens[tokens_in_exp].type = ENDOFFILE;
+    formula->tokens_in_exp = tokens_in_exp;
+    formula->inputs = inputs;
+    formula->input_count = input_count;
+    formula->visited = 0;
+
+    if (ctx->formula_count == ctx->formula_capacity) {
+        ctx->formula_capacity = ctx->formula_capacity
+            ? ctx->formula_capacity * 2 : 8;
+        ctx->formulas = realloc(ctx->formulas,
+            ctx->formula_capacity * sizeof(Formula*));
+    }
+    ctx->formulas[ctx->formula_count++] = formula;
+    return 1;
+}
+
+/*
+ * Stops watching the formula assigning the specified identifier, if any
+ */
+void unwatch(const char* target)
+{
+    int existing = find_formula(target);
+    if (existing < 0)
+        return;
+    free_formula(ctx->formulas[existing]);
+    ctx->formulas[existing] = ctx->formulas[--ctx->formula_count];
+}
+
+/*
+ * Records that the current expression assigned an identifier. Formulas
+ * reading it are recomputed by propagate_change() once the expression's
+ * result has been printed.
+ */
+void note_change(const char* name)
+{
+    free(ctx->pending_change);
+    ctx->pending_change = strdup(name);
+}
+
+/*
+ * Recomputes every formula downstream of the identifier recorded by
+ * note_change(), in dependency order, printing each new value.
+ */
+void propagate_change()
+{
+    if (ctx->pending_change == NULL)
+        return;
+
+    Formula** order = malloc((ctx->formula_count + 1) * sizeof(Formula*));
+    int count = 0;
+    collect_dependents(ctx->pending_change, order, &count);
+    free(ctx->pending_change);
+    ctx->pending_change = NULL;
+
+    for (int i = 0; i < count; i++)
+        order[i]->visited = 0;
+
+    /* collect_dependents() produced the order in reverse */
+    for (int i = count - 1; i >= 0 && !ctx->error_encountered; i--) {
+        Token* target = get_identifier(order[i]->target);
+        int to_shell = binds_shell_variable(target);
+        Value value = evaluate_formula(order[i]);
+        if (ctx->error_encountered) {
+            free_value(&value);
+            break;
+        }
+        value = assign_lvalue(target, value, to_shell, 0);
+        fprintf(ctx->out, "%s = ", order[i]->target);
+        print_value(value, &ctx->output_format);
+        free_value(&value);
+    }
+    free(order);
+
+    /* Recomputing formulas records their targets, which are already done */
+    free(ctx->pending_change);
+    ctx->pending_change = NULL;
+}
+
+/*
+ * Prints each watched formula to stdout
+ */
+void list_watches()
+{
+    for (int i = 0; i < ctx->formula_count; i++)
+        fprintf(ctx->out, "%s\n", ctx->formulas[i]->text);
+}
+
+/*
+ * Stops watching every formula, see free_context()
+ */
+void free_watches()
+{
+    for (int i = 0; i < ctx->formula_count; i++)
+        free_formula(ctx->formulas[i]);
+    free(ctx->formulas);
+    free(ctx->pending_change);
+    ctx->formulas = NULL;
+    ctx->formula_count = ctx->formula_capacity = 0;
+    ctx->pending_change = NULL;
+}
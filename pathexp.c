@@ -72,6 +72,11 @@ unquoted_glob_pattern_p (string)
 
   DECLARE_MBSTATE;
 
+  /* Most words have none of the characters that could start a pattern;
+     a byte scan rules those out without stepping through characters. */
+  if (string[strcspn (string, "?*[+@!/")] == '\0')
+    return (0);
+
   open = bsquote = 0;
   send = string + strlen (string);
 
@@ -406,6 +411,56 @@ quote_globbing_chars (string)
   return temp;
 }
 
+/* If PATTERN, as quoted by quote_string_for_globbing, has no unquoted
+   pattern characters, it matches only itself: return that text, with the
+   backslashes quoting it removed, in new memory.  Otherwise return NULL. */
+char *
+literal_glob_pattern (pattern)
+     const char *pattern;
+{
+  char *ret, *r;
+  const char *p;
+
+#if defined (HANDLE_MULTIBYTE)
+  /* A backslash byte can be part of a character in some encodings */
+  if (locale_mb_cur_max > 1 && locale_utf8locale == 0 && mbsmbchar (pattern))
+    return ((char *)NULL);
+#endif
+
+  ret = r = (char *)xmalloc (strlen (pattern) + 1);
+  for (p = pattern; *p; p++)
+    {
+      switch (*p)
+	{
+	case '*':
+	case '?':
+	case '[':
+	  free (ret);
+	  return ((char *)NULL);
+	case '+':
+	case '@':
+	case '!':
+	  if (extended_glob && p[1] == '(')	/*)*/
+	    {
+	      free (ret);
+	      return ((char *)NULL);
+	    }
+	  break;
+	case '\\':
+	  /* A trailing backslash is special to strmatch */
+	  if (*++p == '\0')
+	    {
+	      free (ret);
+	      return ((char *)NULL);
+	    }
+	  break;
+	}
+      *r++ = *p;
+    }
+  *r = '\0';
+  return ret;
+}
+
 /* Call the glob library to do globbing on PATHNAME. */
 char **
 shell_glob_filename (pathname, qflags)
@@ -69,6 +69,10 @@ extern char *quote_string_for_globbing PARAMS((const char *, int));
 extern int glob_char_p PARAMS((const char *));
 extern char *quote_globbing_chars PARAMS((const char *));
 
+/* Return the string PATTERN matches if it has no unquoted pattern
+   characters, NULL otherwise. */
+extern char *literal_glob_pattern PARAMS((const char *));
+
 /* Call the glob library to do globbing on PATHNAME. FLAGS is additional
    flags to pass to QUOTE_STRING_FOR_GLOBBING, mostly having to do with
    whether or not we've already performed quote removal. */
@@ -52,6 +52,11 @@
 #include "trap.h"
 #include "pathexp.h"
 #include "mailcheck.h"
+#include "redir.h"
+
+#if defined (ALIAS)
+#  include "alias.h"
+#endif
 
 #include "shmbutil.h"
 #if defined (HAVE_MBSTR_H) && defined (HAVE_MBSCHR)
@@ -75,6 +80,34 @@ extern int errno;
 #define DEFAULT_INITIAL_ARRAY_SIZE 112
 #define DEFAULT_ARRAY_SIZE 128
 
+/* A string built up a piece at a time; see strbuf_init. */
+typedef struct strbuf
+{
+  char *s;
+  size_t len;
+  size_t size;
+  char inl[DEFAULT_INITIAL_ARRAY_SIZE];
+} STRBUF;
+
+#define STRBUF_RESERVE(sb, n) \
+  do { \
+    if ((sb)->len + (n) >= (sb)->size) \
+      strbuf_grow ((sb), (n)); \
+  } while (0)
+
+#define STRBUF_ADDC(sb, c) \
+  do { \
+    STRBUF_RESERVE ((sb), 1); \
+    (sb)->s[(sb)->len++] = (c); \
+    (sb)->s[(sb)->len] = '\0'; \
+  } while (0)
+
+/* The characters quoting and quote removal work on.  A string without
+   any of them, found with one strcspn, passes through those unchanged. */
+static const char ctlchars[] = { CTLESC, CTLNUL, '\0' };
+
+#define NO_CTLCHARS(s)	((s)[strcspn ((s), ctlchars)] == '\0')
+
 /* Variable types. */
 #define VT_VARIABLE	0
 #define VT_POSPARMS	1
@@ -155,6 +188,17 @@ char *ifs_value;
 unsigned char ifs_cmap[UCHAR_MAX + 1];
 int ifs_is_set, ifs_is_null;
 
+/* How list_string classifies each byte when IFS is all single-byte
+   characters and contains neither CTLESC nor CTLNUL (ifs_split_ok). */
+#define IFS_SPLIT_WORD	0	/* part of a field */
+#define IFS_SPLIT_WHITE	1	/* IFS white space */
+#define IFS_SPLIT_DELIM	2	/* other IFS character */
+
+static int ifs_split_ok;
+static unsigned char ifs_split_class[UCHAR_MAX + 1];
+/* The bytes that end a field: the IFS characters, CTLESC and CTLNUL */
+static char ifs_split_stop[UCHAR_MAX + 1];
+
 #if defined (HANDLE_MULTIBYTE)
 unsigned char ifs_firstc[MB_LEN_MAX];
 size_t ifs_firstc_len;
@@ -254,6 +298,12 @@ static SHELL_VAR *do_compound_assignment PARAMS((char *, char *, int));
 #endif
 static int do_assignment_internal PARAMS((const WORD_DESC *, int));
 
+static void strbuf_init PARAMS((STRBUF *));
+static void strbuf_grow PARAMS((STRBUF *, size_t));
+static void strbuf_append PARAMS((STRBUF *, const char *, size_t));
+static char *strbuf_release PARAMS((STRBUF *));
+static void strbuf_free PARAMS((STRBUF *));
+
 static char *string_extract_verbatim PARAMS((char *, size_t, int *, char *, int));
 static char *string_extract PARAMS((char *, int *, char *, int));
 static char *string_extract_double_quoted PARAMS((char *, int *, int));
@@ -272,12 +322,16 @@ static char *remove_upattern PARAMS((char *, char *, int));
 #if defined (HANDLE_MULTIBYTE) 
 static wchar_t *remove_wpattern PARAMS((wchar_t *, size_t, wchar_t *, int));
 #endif
+static int remove_lpattern PARAMS((char *, char *, int, char **));
+static int remove_cpattern PARAMS((char *, char *, int, char **));
 static char *remove_pattern PARAMS((char *, char *, int));
 
 static int match_upattern PARAMS((char *, char *, int, char **, char **));
 #if defined (HANDLE_MULTIBYTE)
 static int match_wpattern PARAMS((wchar_t *, char **, size_t, wchar_t *, int, char **, char **));
 #endif
+static char *literal_subst PARAMS((char *, char *, char *, int));
+static int match_cpattern PARAMS((STRMATCHER *, char *, char *, char *, char *, int, char **, char **));
 static int match_pattern PARAMS((char *, char *, int, char **, char **));
 static int getpatspec PARAMS((int, char *));
 static char *getpattern PARAMS((char *, int, int));
@@ -461,10 +515,10 @@ dump_word_flags (flags)
       f &= ~W_NOCOMSUB;
       fprintf (stderr, "W_NOCOMSUB%s", f ? "|" : "");
     }
-  if (f & W_DOLLARSTAR)
+  if (f & W_NOCTLCHARS)
     {
-      f &= ~W_DOLLARSTAR;
-      fprintf (stderr, "W_DOLLARSTAR%s", f ? "|" : "");
+      f &= ~W_NOCTLCHARS;
+      fprintf (stderr, "W_NOCTLCHARS%s", f ? "|" : "");
     }
   if (f & W_DOLLARAT)
     {
@@ -744,8 +798,12 @@ sub_append_string (source, target, indx, size)
       srclen = STRLEN (source);
       if (srclen >= (int)(*size - *indx))
 	{
+	  /* Grow geometrically, so that appending many pieces costs a
+	     logarithmic number of reallocs */
 	  n = srclen + *indx;
 	  n = (n + DEFAULT_ARRAY_SIZE) - (n % DEFAULT_ARRAY_SIZE);
+	  if (n < 2 * *size)
+	    n = 2 * *size;
 	  target = (char *)xrealloc (target, (*size = n));
 	}
 
@@ -776,6 +834,84 @@ sub_append_number (number, target, indx, size)
 }
 #endif
 
+/* A string builder.  A string that stays short is built in INL, inside
+   the builder itself, and costs no allocation until it is released;
+   longer strings move to malloced memory that doubles in size as it
+   fills.  S is always NUL-terminated. */
+
+static void
+strbuf_init (sb)
+     STRBUF *sb;
+{
+  sb->s = sb->inl;
+  sb->len = 0;
+  sb->size = sizeof (sb->inl);
+  sb->s[0] = '\0';
+}
+
+/* Make room for at least N more characters and the terminating NUL. */
+static void
+strbuf_grow (sb, n)
+     STRBUF *sb;
+     size_t n;
+{
+  size_t nsize;
+
+  if (sb->len + n < sb->size)
+    return;
+  nsize = sb->size * 2;
+  if (nsize <= sb->len + n)
+    nsize = sb->len + n + 1;
+  if (sb->s == sb->inl)
+    {
+      sb->s = (char *)xmalloc (nsize);
+      memcpy (sb->s, sb->inl, sb->len + 1);
+    }
+  else
+    sb->s = (char *)xrealloc (sb->s, nsize);
+  sb->size = nsize;
+}
+
+static void
+strbuf_append (sb, str, n)
+     STRBUF *sb;
+     const char *str;
+     size_t n;
+{
+  STRBUF_RESERVE (sb, n);
+  memcpy (sb->s + sb->len, str, n);
+  sb->len += n;
+  sb->s[sb->len] = '\0';
+}
+
+/* Return the string built in SB as newly-allocated memory, leaving SB
+   empty. */
+static char *
+strbuf_release (sb)
+     STRBUF *sb;
+{
+  char *ret;
+
+  if (sb->s == sb->inl)
+    {
+      ret = (char *)xmalloc (sb->len + 1);
+      memcpy (ret, sb->inl, sb->len + 1);
+    }
+  else
+    ret = sb->s;
+  strbuf_init (sb);
+  return ret;
+}
+
+static void
+strbuf_free (sb)
+     STRBUF *sb;
+{
+  if (sb->s != sb->inl)
+    free (sb->s);
+  strbuf_init (sb);
+}
+
 /* Extract a substring from STRING, starting at SINDEX and ending with
    one of the characters in CHARLIST.  Don't make the ending character
    part of the string.  Leave SINDEX pointing at the ending character.
@@ -2790,6 +2926,84 @@ string_list_pos_params (pchar, list, quoted, pflags)
 #define ifs_whitesep(c)	((sh_style_split || separators == 0) ? spctabnl (c) \
 							     : ifs_whitespace (c))
 
+/* Split STRING, which has no leading IFS white space, on the characters
+   in $IFS in a single pass, using the byte classes built by setifs.  Each
+   field is found with strcspn and copied directly into its word.  Returns
+   -1 without a result if STRING contains CTLESC or CTLNUL, which need the
+   general code in list_string, and 0 otherwise. */
+static int
+list_string_ifs (string, sh_style_split, resultp)
+     char *string;
+     int sh_style_split;
+     WORD_LIST **resultp;
+{
+  WORD_LIST *result, *tail;
+  WORD_DESC *t;
+  char *s;
+  size_t len;
+  int c;
+
+  result = tail = (WORD_LIST *)NULL;
+  for (s = string; *s; )
+    {
+      len = strcspn (s, ifs_split_stop);
+      c = (unsigned char)s[len];
+      if (c && ifs_split_class[c] == IFS_SPLIT_WORD)	/* CTLESC or CTLNUL */
+	{
+	  dispose_words (result);
+	  return -1;
+	}
+
+      if (len > 0)
+	{
+	  t = alloc_word_desc ();
+	  t->word = (char *)xmalloc (len + 1);
+	  memcpy (t->word, s, len);
+	  t->word[len] = '\0';
+	  t->flags |= W_NOCTLCHARS;
+	}
+      /* A field delimited by two non-whitespace IFS characters is empty */
+      else if (sh_style_split == 0 && ifs_split_class[c] == IFS_SPLIT_DELIM)
+	{
+	  t = alloc_word_desc ();
+	  t->word = make_quoted_char ('\0');
+	  t->flags |= W_QUOTED|W_HASQUOTEDNULL;
+	}
+      else
+	t = 0;
+
+      if (t)
+	{
+	  if (result == 0)
+	    result = tail = make_word_list (t, (WORD_LIST *)NULL);
+	  else
+	    tail = tail->next = make_word_list (t, (WORD_LIST *)NULL);
+	}
+
+      s += len;
+      if (c == 0)
+	break;
+
+      /* Skip the delimiter: a run of IFS white space, optionally followed
+	 by one other IFS character and the IFS white space after it. */
+      s++;
+      if (ifs_split_class[c] == IFS_SPLIT_WHITE)
+	{
+	  while (ifs_split_class[(unsigned char)*s] == IFS_SPLIT_WHITE)
+	    s++;
+	  if (ifs_split_class[(unsigned char)*s] == IFS_SPLIT_DELIM)
+	    s++;
+	  else
+	    continue;
+	}
+      while (ifs_split_class[(unsigned char)*s] == IFS_SPLIT_WHITE)
+	s++;
+    }
+
+  *resultp = result;
+  return 0;
+}
+
 WORD_LIST *
 list_string (string, separators, quoted)
      register char *string, *separators;
@@ -2837,6 +3051,16 @@ list_string (string, separators, quoted)
       string = s;
     }
 
+  /* Without quoting or multibyte characters to worry about, $IFS can be
+     applied a byte at a time. */
+  if (quoted == 0 && ifs_split_ok && separators && *separators &&
+      (separators == ifs_value || STREQ (separators, ifs_value)) &&
+#if defined (HANDLE_MULTIBYTE)
+      (locale_mb_cur_max == 1 || locale_utf8locale) &&
+#endif
+      list_string_ifs (string, sh_style_split, &result) == 0)
+    return (result);
+
   /* OK, now STRING points to a word that does not begin with white space.
      The splitting algorithm is:
 	extract a word, stopping at a separator
@@ -4090,8 +4314,9 @@ quote_escapes_internal (string, flags)
 {
   const char *s, *send;
   char *t, *result;
+  char stop[4];
   size_t slen;
-  int quote_spaces, skip_ctlesc, skip_ctlnul, nosplit;
+  int quote_spaces, skip_ctlesc, skip_ctlnul, nosplit, n;
   DECLARE_MBSTATE; 
 
   slen = strlen (string);
@@ -4106,6 +4331,22 @@ quote_escapes_internal (string, flags)
       skip_ctlnul |= (nosplit == 0 && *s == CTLNUL);
     }
 
+  /* Most strings have nothing to quote; copy those in one go. */
+  n = 0;
+  if (skip_ctlesc == 0)
+    stop[n++] = CTLESC;
+  if (skip_ctlnul == 0)
+    stop[n++] = CTLNUL;
+  if (quote_spaces)
+    stop[n++] = ' ';
+  stop[n] = '\0';
+  if (string[strcspn (string, stop)] == '\0')
+    {
+      result = (char *)xmalloc (slen + 1);
+      memcpy (result, string, slen + 1);
+      return (result);
+    }
+
   t = result = (char *)xmalloc ((slen * 2) + 1);
   s = string;
 
@@ -4143,8 +4384,12 @@ list_quote_escapes (list)
 
   for (w = list; w; w = w->next)
     {
+      /* Without CTLESC or CTLNUL, only spaces might need quoting */
+      if ((w->word->flags & W_NOCTLCHARS) && (ifs_value == 0 || *ifs_value))
+	continue;
       t = w->word->word;
       w->word->word = quote_escapes (t);
+      w->word->flags &= ~W_NOCTLCHARS;
       free (t);
     }
   return list;
@@ -4210,6 +4455,8 @@ list_dequote_escapes (list)
 
   for (w = list; w; w = w->next)
     {
+      if (w->word->flags & W_NOCTLCHARS)
+	continue;
       t = w->word->word;
       w->word->word = dequote_escapes (t);
       free (t);
@@ -4348,6 +4595,7 @@ quote_list (list)
       if (*t == 0)
 	w->word->flags |= W_HASQUOTEDNULL;	/* XXX - turn on W_HASQUOTEDNULL here? */
       w->word->flags |= W_QUOTED;
+      w->word->flags &= ~W_NOCTLCHARS;
       free (t);
     }
   return list;
@@ -4378,6 +4626,8 @@ dequote_list (list)
 
   for (tlist = list; tlist; tlist = tlist->next)
     {
+      if (tlist->word->flags & W_NOCTLCHARS)
+	continue;
       s = dequote_string (tlist->word->word);
       if (QUOTED_NULL (tlist->word->word))
 	tlist->word->flags &= ~W_HASQUOTEDNULL;
@@ -4499,7 +4749,8 @@ word_list_remove_quoted_nulls (list)
 
   for (t = list; t; t = t->next)
     {
-      remove_quoted_nulls (t->word->word);
+      if ((t->word->flags & W_NOCTLCHARS) == 0)
+	remove_quoted_nulls (t->word->word);
       t->word->flags &= ~W_HASQUOTEDNULL;
     }
 }
@@ -4693,6 +4944,88 @@ remove_wpattern (wparam, wstrlen, wpattern, op)
 }
 #endif /* HANDLE_MULTIBYTE */
 
+/* Return non-zero if a literal pattern can be found in STRING by comparing
+   bytes: it can't then match in the middle of a multibyte character. */
+#if defined (HANDLE_MULTIBYTE)
+#  define BYTE_SEARCH_OK(string) \
+	(locale_mb_cur_max == 1 || locale_utf8locale || mbsmbchar (string) == 0)
+#else
+#  define BYTE_SEARCH_OK(string)	1
+#endif
+
+/* Remove the portion of PARAM matched by PATTERN according to OP if
+   PATTERN has no pattern characters, when the longest and shortest
+   matches are the same and only one comparison is needed.  Returns 0 if
+   PATTERN is not literal; otherwise *RETP is new memory. */
+static int
+remove_lpattern (param, pattern, op, retp)
+     char *param, *pattern;
+     int op;
+     char **retp;
+{
+  char *lit;
+  size_t plen, llen;
+
+  if (BYTE_SEARCH_OK (param) == 0 || (lit = literal_glob_pattern (pattern)) == 0)
+    return 0;
+
+  plen = strlen (param);
+  llen = strlen (lit);
+  if (llen > plen)
+    *retp = savestring (param);
+  else if (op == RP_LONG_LEFT || op == RP_SHORT_LEFT)
+    *retp = savestring (STREQN (param, lit, llen) ? param + llen : param);
+  else
+    *retp = STREQ (param + plen - llen, lit) ? substring (param, 0, plen - llen)
+					       : savestring (param);
+
+  free (lit);
+  return 1;
+}
+
+/* Remove the portion of PARAM matched by PATTERN according to OP with a
+   compiled pattern, which finds the match in one pass over PARAM instead
+   of trying strmatch at every position.  Returns 0 if PATTERN could not
+   be compiled; otherwise *RETP is new memory. */
+static int
+remove_cpattern (param, pattern, op, retp)
+     char *param, *pattern;
+     int op;
+     char **retp;
+{
+  STRMATCHER *m;
+  char *end, *p;
+  int matched, mb;
+
+#if defined (HANDLE_MULTIBYTE)
+  mb = MB_CUR_MAX > 1 && mbsmbchar (param);
+  if (mb && locale_utf8locale == 0)
+    return 0;
+#else
+  mb = 0;
+#endif
+  if ((m = strmatch_lookup (pattern, FNMATCH_EXTFLAG)) == 0)
+    return 0;
+  /* Only patterns whose matches can't end inside a multibyte character
+     are matched byte by byte against one */
+  if (mb && strmatch_bytewise (m) == 0)
+    return 0;
+
+  end = param + strlen (param);
+  if (op == RP_LONG_LEFT || op == RP_SHORT_LEFT)
+    {
+      matched = strmatch_prefix (m, param, end, op == RP_LONG_LEFT, &p);
+      *retp = savestring (matched ? p : param);
+    }
+  else
+    {
+      matched = strmatch_suffix (m, param, end, op == RP_LONG_RIGHT, &p);
+      *retp = matched ? substring (param, 0, p - param) : savestring (param);
+    }
+
+  return 1;
+}
+
 static char *
 remove_pattern (param, pattern, op)
      char *param, *pattern;
@@ -4705,6 +5038,10 @@ remove_pattern (param, pattern, op)
   if (*param == '\0' || pattern == NULL || *pattern == '\0')	/* minor optimization */
     return (savestring (param));
 
+  if (remove_lpattern (param, pattern, op, &xret) ||
+      remove_cpattern (param, pattern, op, &xret))
+    return (xret);
+
 #if defined (HANDLE_MULTIBYTE)
   if (MB_CUR_MAX > 1)
     {
@@ -5068,6 +5405,43 @@ match_wpattern (wstring, indices, wstrlen, wpat, mtype, sp, ep)
 #undef WFOLD
 #endif /* HANDLE_MULTIBYTE */
 
+/* Match with the compiled pattern M as match_pattern would match STRING,
+   which lies within BASE.  For MATCH_ANY, STARTS flags each position of
+   BASE where a match begins (see strmatch_starts), so the leftmost match
+   is the first flagged position and only its longest end has to be
+   found. */
+static int
+match_cpattern (m, starts, base, string, end, mtype, sp, ep)
+     STRMATCHER *m;
+     char *starts, *base, *string, *end;
+     int mtype;
+     char **sp, **ep;
+{
+  char *p;
+
+  switch (mtype)
+    {
+    case MATCH_ANY:
+      for (p = string; p <= end; p++)
+	if (starts[p - base])
+	  {
+	    *sp = p;
+	    return (strmatch_prefix (m, p, end, 1, ep));
+	  }
+      return (0);
+
+    case MATCH_BEG:
+      *sp = string;
+      return (strmatch_prefix (m, string, end, 1, ep));
+
+    case MATCH_END:
+      *ep = end;
+      return (strmatch_suffix (m, string, end, 1, sp));
+    }
+
+  return (0);
+}
+
 static int
 match_pattern (string, pat, mtype, sp, ep)
      char *string, *pat;
@@ -5243,7 +5617,7 @@ array_remove_pattern (var, pattern, patspec, starsub, quoted)
      int quoted;
 {
   ARRAY *a;
-  HASH_TABLE *h;
+  ASSOC *h;
   int itype;
   char *ret;
   WORD_LIST *list;
@@ -6164,26 +6538,30 @@ process_substitute (string, open_for_read_in_child)
 /*				   */
 /***********************************/
 
+/* Command substitution output is read this many bytes at a time, the
+   capacity of a pipe on most systems. */
+#define COMSUB_BUFSIZ	65536
+
 static char *
 read_comsub (fd, quoted, flags, rflag)
      int fd, quoted, flags;
      int *rflag;
 {
-  char *istring, buf[512], *bufp;
+  char *istring, *buf, *bufp, *bufend, *s;
   int istring_index, c, tflag, skip_ctlesc, skip_ctlnul;
-  int mb_cur_max;
-  size_t istring_size;
+  int mb_cur_max, quote_all, eof;
+  size_t istring_size, need, carry;
   ssize_t bufn;
   int nullbyte;
+  char special[UCHAR_MAX + 1];
 #if defined (HANDLE_MULTIBYTE)
   mbstate_t ps;
   wchar_t wc;
   size_t mblen;
-  int i;
 #endif
 
   istring = (char *)NULL;
-  istring_index = istring_size = bufn = tflag = 0;
+  istring_index = istring_size = tflag = 0;
 
   skip_ctlesc = ifs_cmap[CTLESC];
   skip_ctlnul = ifs_cmap[CTLNUL];
@@ -6191,72 +6569,108 @@ read_comsub (fd, quoted, flags, rflag)
   mb_cur_max = MB_CUR_MAX;
   nullbyte = 0;
 
-  /* Read the output of the command through the pipe. */
-  while (1)
-    {
-      if (fd < 0)
-	break;
-      if (--bufn <= 0)
-	{
-	  bufn = zread (fd, buf, sizeof (buf));
-	  if (bufn <= 0) 
+  /* Inside double quotes every character is quoted, which is essentially
+     quote_string inline.  Otherwise only the bytes marked in SPECIAL are:
+     CTLESC and CTLNUL are escaped to protect them from the rest of the
+     word expansions (word splitting and globbing), which is essentially
+     quote_escapes inline, and null bytes are dropped. */
+  quote_all = (quoted & (Q_HERE_DOCUMENT|Q_DOUBLE_QUOTES)) != 0;
+  memset (special, 0, sizeof (special));
+  special[0] = 1;
+  special[CTLESC] = skip_ctlesc == 0 || (flags & PF_ASSIGNRHS);
+  special[CTLNUL] = skip_ctlnul == 0;
+  if (ifs_value && *ifs_value == 0)
+    special[' '] = 1;
+
+  /* Not static: a trap run while we wait for input may perform a command
+     substitution of its own.  Every caller has begun an unwind frame. */
+  buf = (char *)xmalloc (COMSUB_BUFSIZ);
+  add_unwind_protect (xfree, buf);
+
+  /* Read the output of the command through the pipe.  CARRY bytes of an
+     incomplete multibyte character are kept at the start of the buffer
+     until the rest of it arrives. */
+  carry = 0;
+  for (eof = (fd < 0); eof == 0; )
+    {
+      bufn = zread (fd, buf + carry, COMSUB_BUFSIZ - carry);
+      if (bufn <= 0)
+	{
+	  if (carry == 0)
 	    break;
-	  bufp = buf;
+	  eof = 1;
+	  bufn = 0;
 	}
-      c = *bufp++;
+      bufp = buf;
+      bufend = buf + carry + bufn;
+      carry = 0;
 
-      if (c == 0)
+      /* Each byte takes at most two in ISTRING */
+      need = istring_index + 2 * (bufend - bufp) + 1;
+      if (need > istring_size)
 	{
-#if 1
-	  if (nullbyte == 0)
+	  istring_size = (istring_size * 2 > need) ? istring_size * 2 : need;
+	  istring = (char *)xrealloc (istring, istring_size);
+	}
+
+      while (bufp < bufend)
+	{
+	  if (quote_all == 0)
 	    {
-	      internal_warning ("%s", _("command substitution: ignored null byte in input"));
-	      nullbyte = 1;
+	      for (s = bufp; s < bufend && special[(unsigned char)*s] == 0; s++)
+		;
+	      memcpy (istring + istring_index, bufp, s - bufp);
+	      istring_index += s - bufp;
+	      if (s == bufend)
+		break;
+	      bufp = s;
 	    }
-#endif
-	  continue;
-	}
 
-      /* Add the character to ISTRING, possibly after resizing it. */
-      RESIZE_MALLOCED_BUFFER (istring, istring_index, mb_cur_max+1, istring_size, 512);
+	  c = (unsigned char)*bufp;
+	  if (c == 0)
+	    {
+	      if (nullbyte == 0)
+		{
+		  internal_warning ("%s", _("command substitution: ignored null byte in input"));
+		  nullbyte = 1;
+		}
+	      bufp++;
+	      continue;
+	    }
 
-      /* This is essentially quote_string inline */
-      if ((quoted & (Q_HERE_DOCUMENT|Q_DOUBLE_QUOTES)) /* || c == CTLESC || c == CTLNUL */)
-	istring[istring_index++] = CTLESC;
-      else if ((flags & PF_ASSIGNRHS) && skip_ctlesc && c == CTLESC)
-	istring[istring_index++] = CTLESC;
-      /* Escape CTLESC and CTLNUL in the output to protect those characters
-	 from the rest of the word expansions (word splitting and globbing.)
-	 This is essentially quote_escapes inline. */
-      else if (skip_ctlesc == 0 && c == CTLESC)
-	istring[istring_index++] = CTLESC;
-      else if ((skip_ctlnul == 0 && c == CTLNUL) || (c == ' ' && (ifs_value && *ifs_value == 0)))
-	istring[istring_index++] = CTLESC;
+	  istring[istring_index++] = CTLESC;
 
 #if defined (HANDLE_MULTIBYTE)
-      if ((locale_utf8locale && (c & 0x80)) ||
-	  (locale_utf8locale == 0 && mb_cur_max > 1 && (unsigned char)c > 127))
-	{
-	  /* read a multibyte character from buf */
-	  /* punt on the hard case for now */
-	  memset (&ps, '\0', sizeof (mbstate_t));
-	  mblen = mbrtowc (&wc, bufp-1, bufn+1, &ps);
-	  if (MB_INVALIDCH (mblen) || mblen == 0 || mblen == 1)
-	    istring[istring_index++] = c;
-	  else
+	  /* Quote a multibyte character as a whole */
+	  if (quote_all && c > 127 && (locale_utf8locale || mb_cur_max > 1))
 	    {
-	      istring[istring_index++] = c;
-	      for (i = 0; i < mblen-1; i++)
-		istring[istring_index++] = *bufp++;
-	      bufn -= mblen - 1;
+	      memset (&ps, '\0', sizeof (mbstate_t));
+	      mblen = mbrtowc (&wc, bufp, bufend - bufp, &ps);
+	      if (mblen == (size_t)-2 && eof == 0 && bufend - bufp < mb_cur_max)
+		{
+		  istring_index--;
+		  carry = bufend - bufp;
+		  memmove (buf, bufp, carry);
+		  break;
+		}
+	      else if (MB_INVALIDCH (mblen) == 0 && mblen > 1)
+		{
+		  memcpy (istring + istring_index, bufp, mblen);
+		  istring_index += mblen;
+		  bufp += mblen;
+		  continue;
+		}
 	    }
-	  continue;
-	}
 #endif
 
-      istring[istring_index++] = c;
+	  istring[istring_index++] = c;
+	  bufp++;
+	}
     }
 
+  remove_unwind_protect ();
+  free (buf);
+
   if (istring)
     istring[istring_index] = '\0';
 
@@ -6296,6 +6710,287 @@ read_comsub (fd, quoted, flags, rflag)
   return istring;
 }
 
+/* Return the index just past the shell word starting at STRING[I], for
+   comsub_in_process, or -1 if the word contains anything that could
+   expand differently in the shell than in a subshell, or that only the
+   parser handles: command, process and arithmetic substitution, parameter
+   expansion operators, $-, $SHELLOPTS, dynamic variables like $RANDOM
+   and $BASHPID, $'...' and $"..." quoting, comments, line continuations,
+   and tildes that are not at the start of the word. */
+static int
+comsub_scan_word (string, i)
+     char *string;
+     int i;
+{
+  int start, dquote, j, k, bad;
+  char *name;
+  SHELL_VAR *v;
+
+  if (string[i] == '#')
+    return -1;
+
+  for (start = i, dquote = 0; string[i]; )
+    {
+      if (dquote == 0 && (shellblank (string[i]) || string[i] == '\n' || shellmeta (string[i])))
+	break;
+
+      switch (string[i])
+	{
+	case '\\':
+	  if (string[i+1] == '\0' || string[i+1] == '\n')
+	    return -1;
+	  i += 2;
+	  break;
+	case '\'':
+	  if (dquote == 0)
+	    {
+	      for (j = i + 1; string[j] && string[j] != '\''; j++)
+		;
+	      if (string[j] == '\0')
+		return -1;
+	      i = j;
+	    }
+	  i++;
+	  break;
+	case '"':
+	  dquote = 1 - dquote;
+	  i++;
+	  break;
+	case '`':
+	  return -1;
+	case '~':
+	  if (i > start)
+	    return -1;
+	  i++;
+	  break;
+	case '$':
+	  j = (string[i+1] == '{') ? i + 2 : i + 1;
+	  if (legal_variable_starter (string[j]))
+	    {
+	      for (k = j; legal_variable_char (string[k]); k++)
+		;
+	      /* var_lookup, since find_variable would call a dynamic
+		 variable's function, advancing $RANDOM */
+	      name = substring (string, j, k);
+	      v = var_lookup (name, shell_variables);
+	      bad = STREQ (name, "SHELLOPTS") || (v && (v->dynamic_value || nameref_p (v)));
+	      free (name);
+	      if (bad)
+		return -1;
+	    }
+	  else if (DIGIT (string[j]) || (string[j] && strchr ("@*#?$!", string[j])))
+	    k = j + 1;
+	  else
+	    return -1;
+	  if (j == i + 2)
+	    {
+	      if (string[k] != '}')
+		return -1;
+	      k++;
+	    }
+	  i = k;
+	  break;
+	default:
+	  i++;
+	  break;
+	}
+    }
+
+  return (dquote ? -1 : i);
+}
+
+static void
+comsub_restore_stdout (fd)
+     int fd;
+{
+  fflush (stdout);
+  dup2 (fd, 1);
+  close (fd);
+}
+
+/* Try to perform the command substitution of STRING without a child
+   process.  Two forms are handled: $(<file), when FILE names a regular
+   file, and a single echo or printf builtin, whose output is captured in
+   a temporary file.  Everything they do has to be impossible to tell
+   from a subshell running them, so the words are restricted by
+   comsub_scan_word and any shell state a subshell would treat
+   differently makes us give up.  Returns 1 and sets *RETP to the result,
+   or 0 if the caller has to fork; nothing observable has happened then,
+   so the child can report any errors. */
+static int
+comsub_in_process (string, quoted, flags, retp)
+     char *string;
+     int quoted, flags;
+     WORD_DESC **retp;
+{
+  WORD_LIST *list, *words, *oglist;
+  WORD_DESC *w;
+  sh_builtin_func_t *builtin;
+  char *fn, *istring, *name;
+  int i, j, fd, savefd, tflag, result, oerror;
+  struct stat finfo;
+
+  if (expanding_redir || temporary_env || unbound_vars_is_error ||
+	fail_glob_expansion || echo_command_at_execute ||
+	signal_is_trapped (DEBUG_TRAP) || signal_is_trapped (ERROR_TRAP) ||
+	strchr (string, CTLESC) || strchr (string, CTLNUL))
+    return 0;
+
+  istring = (char *)NULL;
+  tflag = 0;
+
+  /* $(<file), which a subshell would handle with cat_file */
+  if (string[0] == '<' && (string[1] == '\0' || strchr ("<>&(|", string[1]) == 0))
+    {
+      for (i = 1; shellblank (string[i]); i++)
+	;
+      j = comsub_scan_word (string, i);
+      if (j <= i)
+	return 0;
+      w = make_word (name = substring (string, i, j));
+      free (name);
+      for (i = j; shellblank (string[i]) || string[i] == '\n'; i++)
+	;
+      if (string[i])
+	{
+	  dispose_word (w);
+	  return 0;
+	}
+
+      oglist = garglist;
+      oerror = tempenv_assign_error;
+      if (posixly_correct && !interactive_shell)
+	disallow_filename_globbing++;
+      fn = redirection_expand (w);
+      if (posixly_correct && !interactive_shell)
+	disallow_filename_globbing--;
+      garglist = oglist;
+      tempenv_assign_error = oerror;
+      dispose_word (w);
+
+      if (fn == 0)
+	return 0;
+      fd = open (fn, O_RDONLY);
+      free (fn);
+      if (fd < 0)
+	return 0;
+      if (fstat (fd, &finfo) < 0 || S_ISREG (finfo.st_mode) == 0)
+	{
+	  close (fd);
+	  return 0;
+	}
+
+      begin_unwind_frame ("read-comsub");
+      add_unwind_protect (close, fd);
+      istring = read_comsub (fd, quoted, flags, &tflag);
+      run_unwind_frame ("read-comsub");
+      result = EXECUTION_SUCCESS;
+    }
+  /* A lone echo or printf */
+  else if ((STREQN (string, "echo", 4) && (string[4] == '\0' || shellblank (string[4]) || string[4] == '\n')) ||
+	   (STREQN (string, "printf", 6) && (string[6] == '\0' || shellblank (string[6]) || string[6] == '\n')))
+    {
+      name = (string[0] == 'e') ? "echo" : "printf";
+#if defined (ALIAS)
+      if (expand_aliases && find_alias (name))
+	return 0;
+#endif
+      builtin = find_shell_builtin (name);
+      if (find_function (name) || builtin == 0 ||
+	    (builtin != echo_builtin && builtin != printf_builtin))
+	return 0;
+
+      list = (WORD_LIST *)NULL;
+      for (i = 0; ; )
+	{
+	  while (shellblank (string[i]))
+	    i++;
+	  /* Anything after a newline is another command */
+	  if (string[i] == '\n')
+	    {
+	      while (shellblank (string[i]) || string[i] == '\n')
+		i++;
+	      if (string[i])
+		{
+		  dispose_words (list);
+		  return 0;
+		}
+	    }
+	  if (string[i] == '\0')
+	    break;
+	  j = comsub_scan_word (string, i);
+	  if (j <= i)
+	    {
+	      dispose_words (list);
+	      return 0;
+	    }
+	  list = make_word_list (make_word (name = substring (string, i, j)), list);
+	  free (name);
+	  i = j;
+	}
+      list = REVERSE_LIST (list, WORD_LIST *);
+
+      /* We may be expanding the words of a command, so preserve the state
+	 expand_word_list_internal keeps for it */
+      oglist = garglist;
+      oerror = tempenv_assign_error;
+      words = expand_words_no_vars (list);
+      garglist = oglist;
+      tempenv_assign_error = oerror;
+      dispose_words (list);
+      /* printf -v assigns a variable, which a subshell would not */
+      if (words == 0 || (builtin == printf_builtin && words->next && words->next->word->word[0] == '-'))
+	{
+	  dispose_words (words);
+	  return 0;
+	}
+
+      fd = sh_mktmpfd ("sh-csub", MT_USERANDOM|MT_USETMPDIR|MT_READWRITE, &fn);
+      if (fd < 0)
+	{
+	  dispose_words (words);
+	  return 0;
+	}
+      unlink (fn);
+      free (fn);
+
+      fflush (stdout);
+      if ((savefd = dup (1)) < 0)
+	{
+	  close (fd);
+	  dispose_words (words);
+	  return 0;
+	}
+
+      begin_unwind_frame ("read-comsub");
+      add_unwind_protect (close, fd);
+      add_unwind_protect (dispose_words, words);
+      unwind_protect_pointer (this_command_name);
+      dup2 (fd, 1);
+      add_unwind_protect (comsub_restore_stdout, savefd);
+
+      this_command_name = words->word->word;
+      result = (*builtin) (words->next);
+
+      comsub_restore_stdout (savefd);
+      remove_unwind_protect ();
+      lseek (fd, 0, SEEK_SET);
+      istring = read_comsub (fd, quoted, flags, &tflag);
+      run_unwind_frame ("read-comsub");
+    }
+  else
+    return 0;
+
+  last_command_exit_value = result;
+  /* Tell execute_simple_command that a command substitution took place */
+  last_command_subst_pid = getpid ();
+
+  *retp = alloc_word_desc ();
+  (*retp)->word = istring;
+  (*retp)->flags = tflag;
+  return 1;
+}
+
 /* Perform command substitution on STRING.  This returns a WORD_DESC * with the
    contained string possibly quoted. */
 WORD_DESC *
@@ -6330,6 +7025,9 @@ command_substitute (string, quoted, flags)
       jump_to_top_level (EXITPROG);
     }
 
+  if (comsub_in_process (s, quoted, flags, &ret))
+    return ret;
+
   /* We're making the assumption here that the command substitution will
      eventually run a command from the file system.  Since we'll run
      maybe_make_export_env in this subshell before executing that command,
@@ -6576,7 +7274,7 @@ array_length_reference (s)
   char *akey;
   char *t, c;
   ARRAY *array;
-  HASH_TABLE *h;
+  ASSOC *h;
   SHELL_VAR *var;
 
   var = array_variable_part (s, 0, &t, &len);
@@ -6600,7 +7298,7 @@ array_length_reference (s)
      v[*].  Return 0 for everything else. */
 
   array = array_p (var) ? array_cell (var) : (ARRAY *)NULL;
-  h = assoc_p (var) ? assoc_cell (var) : (HASH_TABLE *)NULL;
+  h = assoc_p (var) ? assoc_cell (var) : (ASSOC *)NULL;
 
   if (ALL_ELEMENT_SUB (t[0]) && t[1] == RBRACK)
     {
@@ -7418,7 +8116,7 @@ verify_substring_values (v, value, substr, vtype, e1p, e2p)
   int expok;
 #if defined (ARRAY_VARS)
  ARRAY *a;
- HASH_TABLE *h;
+ ASSOC *h;
 #endif
 
   /* duplicate behavior of strchr(3) */
@@ -7862,7 +8560,7 @@ array_transform (xc, var, starsub, quoted)
      int quoted;
 {
   ARRAY *a;
-  HASH_TABLE *h;
+  ASSOC *h;
   int itype;
   char *ret;
   WORD_LIST *list;
@@ -8040,6 +8738,18 @@ mb_substring (string, s, e)
   size_t slen;
   DECLARE_MBSTATE;
 
+  /* In a UTF-8 locale, find the offsets without calling mbrlen for every
+     character. */
+  if (locale_utf8locale)
+    {
+      char *end, *sp, *ep;
+
+      end = string + strlen (string);
+      sp = utf8_mbsadvance (string, end, s, (size_t *)NULL);
+      ep = utf8_mbsadvance (sp, end, e - s, (size_t *)NULL);
+      return (substring (string, sp - string, ep - string));
+    }
+
   start = 0;
   /* Don't need string length in ADVANCE_CHAR unless multibyte chars possible. */
   slen = (MB_CUR_MAX > 1) ? STRLEN (string) : 0;
@@ -8184,14 +8894,80 @@ shouldexp_replacement (s)
 }
 #endif
 
+/* Substitute REP for LIT, a pattern without pattern characters, in STRING
+   as pat_subst would.  Matches of a literal can't overlap or differ in
+   length, so they are counted first and the result is allocated once. */
+static char *
+literal_subst (string, lit, rep, mflags)
+     char *string, *lit, *rep;
+     int mflags;
+{
+  char *ret, *r, *s, *t;
+  size_t slen, llen, replen, nmatch;
+  int mtype;
+
+  mtype = mflags & MATCH_TYPEMASK;
+  slen = strlen (string);
+  llen = strlen (lit);
+  replen = STRLEN (rep);
+
+  nmatch = 0;
+  if (llen > slen)
+    ;
+  else if (mtype == MATCH_BEG)
+    nmatch = STREQN (string, lit, llen);
+  else if (mtype == MATCH_END)
+    nmatch = STREQ (string + slen - llen, lit);
+  else
+    for (s = string; (s = strstr (s, lit)); s += llen)
+      {
+	nmatch++;
+	if ((mflags & MATCH_GLOBREP) == 0)
+	  break;
+      }
+
+  if (nmatch == 0)
+    return (savestring (string));
+
+  r = ret = (char *)xmalloc (slen - nmatch * llen + nmatch * replen + 1);
+  if (mtype == MATCH_END)
+    {
+      memcpy (r, string, slen - llen);
+      r += slen - llen;
+      s = string + slen;
+    }
+  else
+    for (s = string; nmatch--; s = t + llen)
+      {
+	t = (mtype == MATCH_BEG) ? string : strstr (s, lit);
+	memcpy (r, s, t - s);
+	r += t - s;
+	if (replen)
+	  {
+	    memcpy (r, rep, replen);
+	    r += replen;
+	  }
+      }
+  if (mtype == MATCH_END && replen)
+    {
+      memcpy (r, rep, replen);
+      r += replen;
+    }
+  strcpy (r, s);
+
+  return ret;
+}
+
 char *
 pat_subst (string, pat, rep, mflags)
      char *string, *pat, *rep;
      int mflags;
 {
-  char *ret, *s, *e, *str, *rstr, *mstr, *send;
-  int rptr, mtype, rxpand, mlen;
-  size_t rsize, l, replen, rslen;
+  char *ret, *s, *e, *str, *rstr, *mstr, *send, *starts, *lit;
+  int mtype, rxpand, mlen;
+  size_t l, replen, rslen;
+  STRBUF rb;
+  STRMATCHER *m;
   DECLARE_MBSTATE;
 
   if (string == 0)
@@ -8244,13 +9020,33 @@ pat_subst (string, pat, rep, mflags)
       return (ret);
     }
 
-  ret = (char *)xmalloc (rsize = 64);
-  ret[0] = '\0';
+  if (pat && *pat && rxpand == 0 && match_ignore_case == 0 &&
+      BYTE_SEARCH_OK (string) && (lit = literal_glob_pattern (pat)))
+    {
+      ret = literal_subst (string, lit, rep, mflags);
+      free (lit);
+      return (ret);
+    }
+
   send = string + strlen (string);
+  /* The result is usually about as long as STRING */
+  strbuf_init (&rb);
+  strbuf_grow (&rb, send - string);
+
+  /* Use the compiled pattern for the whole string, when strmatch would
+     have matched it byte by byte anyway. */
+  m = 0;
+  starts = 0;
+#if defined (HANDLE_MULTIBYTE)
+  if (MB_CUR_MAX == 1 || mbsmbchar (string) == 0)
+#endif
+  if (pat && *pat && (m = strmatch_lookup (pat, FNMATCH_EXTFLAG | FNMATCH_IGNCASE)) && mtype == MATCH_ANY)
+    starts = strmatch_starts (m, string, send);
 
-  for (replen = STRLEN (rep), rptr = 0, str = string; *str;)
+  for (replen = STRLEN (rep), str = string; *str;)
     {
-      if (match_pattern (str, pat, mtype, &s, &e) == 0)
+      if (m ? match_cpattern (m, starts, string, str, send, mtype, &s, &e) == 0
+	    : match_pattern (str, pat, mtype, &s, &e) == 0)
 	break;
       l = s - str;
 
@@ -8272,22 +9068,12 @@ pat_subst (string, pat, rep, mflags)
 	  rslen = replen;
 	}
         
-      RESIZE_MALLOCED_BUFFER (ret, rptr, (l + rslen), rsize, 64);
-
-      /* OK, now copy the leading unmatched portion of the string (from
-	 str to s) to ret starting at rptr (the current offset).  Then copy
-	 the replacement string at ret + rptr + (s - str).  Increment
-	 rptr (if necessary) and str and go on. */
+      /* OK, now append the leading unmatched portion of the string (from
+	 str to s) and then the replacement string, and go on. */
       if (l)
-	{
-	  strncpy (ret + rptr, str, l);
-	  rptr += l;
-	}
+	strbuf_append (&rb, str, l);
       if (replen)
-	{
-	  strncpy (ret + rptr, rstr, rslen);
-	  rptr += rslen;
-	}
+	strbuf_append (&rb, rstr, rslen);
       str = e;		/* e == end of match */
 
       if (rstr != rep)
@@ -8303,15 +9089,17 @@ pat_subst (string, pat, rep, mflags)
 	  char *p, *origp, *origs;
 	  size_t clen;
 
-	  RESIZE_MALLOCED_BUFFER (ret, rptr, locale_mb_cur_max, rsize, 64);
+	  STRBUF_RESERVE (&rb, locale_mb_cur_max);
 #if defined (HANDLE_MULTIBYTE)
-	  p = origp = ret + rptr;
+	  p = origp = rb.s + rb.len;
 	  origs = str;
 	  COPY_CHAR_P (p, str, send);
-	  rptr += p - origp;
+	  rb.len += p - origp;
+	  rb.s[rb.len] = '\0';
 	  e += str - origs;
 #else
-	  ret[rptr++] = *str++;
+	  STRBUF_ADDC (&rb, *str);
+	  str++;
 	  e++;		/* avoid infinite recursion on zero-length match */
 #endif
 	}
@@ -8319,14 +9107,11 @@ pat_subst (string, pat, rep, mflags)
 
   /* Now copy the unmatched portion of the input string */
   if (str && *str)
-    {
-      RESIZE_MALLOCED_BUFFER (ret, rptr, STRLEN(str) + 1, rsize, 64);
-      strcpy (ret + rptr, str);
-    }
-  else
-    ret[rptr] = '\0';
+    strbuf_append (&rb, str, send - str);
 
-  return ret;
+  FREE (starts);
+
+  return (strbuf_release (&rb));
 }
 
 /* Do pattern match and replacement on the positional parameters. */
@@ -10036,13 +10821,10 @@ expand_word_internal (word, quoted, isexp, contains_dollar_at, expanded_somethin
   WORD_DESC *tword;
 
   /* The intermediate string that we build while expanding. */
-  char *istring;
-
-  /* The current size of the above object. */
-  size_t istring_size;
+  STRBUF ibuf;
 
-  /* Index into ISTRING. */
-  int istring_index;
+  /* The finished string, once the expansion is done. */
+  char *istring;
 
   /* Temporary string storage. */
   char *temp, *temp1;
@@ -10100,8 +10882,7 @@ expand_word_internal (word, quoted, isexp, contains_dollar_at, expanded_somethin
       return (list);
     }
 
-  istring = (char *)xmalloc (istring_size = DEFAULT_INITIAL_ARRAY_SIZE);
-  istring[istring_index = 0] = '\0';
+  strbuf_init (&ibuf);
   quoted_dollar_at = had_quoted_null = has_dollar_at = 0;
   has_quoted_ifs = 0;
   split_on_spaces = 0;
@@ -10116,6 +10897,10 @@ expand_word_internal (word, quoted, isexp, contains_dollar_at, expanded_somethin
      multibyte characters are possible, but do need it for bounds checking. */
   string_size = (mb_cur_max > 1) ? strlen (string) : 1;
 
+  /* Most words expand to about their own length, so start with that much
+     room; a long here-document body then needs no reallocs. */
+  strbuf_grow (&ibuf, (mb_cur_max > 1) ? string_size : strlen (string));
+
   if (contains_dollar_at)
     *contains_dollar_at = 0;
 
@@ -10156,7 +10941,8 @@ dollar_add_string:
 add_string:
 	  if (temp)
 	    {
-	      istring = sub_append_string (temp, istring, &istring_index, &istring_size);
+	      strbuf_append (&ibuf, temp, strlen (temp));
+	      free (temp);
 	      temp = (char *)0;
 	    }
 
@@ -10323,7 +11109,7 @@ add_string:
 	  if (tword == &expand_wdesc_error || tword == &expand_wdesc_fatal)
 	    {
 	      free (string);
-	      free (istring);
+	      strbuf_free (&ibuf);
 	      return ((tword == &expand_wdesc_error) ? &expand_word_error
 						     : &expand_word_fatal);
 	    }
@@ -10366,7 +11152,7 @@ add_string:
 		set_exit_status (EXECUTION_FAILURE);
 		report_error (_("bad substitution: no closing \"`\" in %s") , string+t_index);
 		free (string);
-		free (istring);
+		strbuf_free (&ibuf);
 		return ((temp == &extract_string_error) ? &expand_word_error
 							: &expand_word_fatal);
 	      }
@@ -10421,21 +11207,15 @@ add_string:
 	  /* This is the fix for " $@\ " */
 	  else if ((quoted & (Q_HERE_DOCUMENT|Q_DOUBLE_QUOTES)) && ((sh_syntaxtab[c] & tflag) == 0) && isexp == 0 && isifs (c))
 	    {
-	      RESIZE_MALLOCED_BUFFER (istring, istring_index, 2, istring_size,
-				      DEFAULT_ARRAY_SIZE);
-	      istring[istring_index++] = CTLESC;
-	      istring[istring_index++] = '\\';
-	      istring[istring_index] = '\0';
+	      STRBUF_ADDC (&ibuf, CTLESC);
+	      STRBUF_ADDC (&ibuf, '\\');
 
 	      SCOPY_CHAR_I (twochars, CTLESC, c, string, sindex, string_size);
 	    }
 	  else if ((quoted & (Q_HERE_DOCUMENT|Q_DOUBLE_QUOTES)) && c == 0)
 	    {
-	      RESIZE_MALLOCED_BUFFER (istring, istring_index, 2, istring_size,
-				      DEFAULT_ARRAY_SIZE);
-	      istring[istring_index++] = CTLESC;
-	      istring[istring_index++] = '\\';
-	      istring[istring_index] = '\0';
+	      STRBUF_ADDC (&ibuf, CTLESC);
+	      STRBUF_ADDC (&ibuf, '\\');
 	      break;	      
 	    }
 	  else if ((quoted & (Q_HERE_DOCUMENT|Q_DOUBLE_QUOTES)) && ((sh_syntaxtab[c] & tflag) == 0))
@@ -10456,11 +11236,7 @@ add_string:
 	  sindex++;
 add_twochars:
 	  /* BEFORE jumping here, we need to increment sindex if appropriate */
-	  RESIZE_MALLOCED_BUFFER (istring, istring_index, 2, istring_size,
-				  DEFAULT_ARRAY_SIZE);
-	  istring[istring_index++] = twochars[0];
-	  istring[istring_index++] = twochars[1];
-	  istring[istring_index] = '\0';
+	  strbuf_append (&ibuf, twochars, 2);
 
 	  break;
 
@@ -10503,7 +11279,7 @@ add_twochars:
 
 	      if (list == &expand_word_error || list == &expand_word_fatal)
 		{
-		  free (istring);
+		  strbuf_free (&ibuf);
 		  free (string);
 		  /* expand_word_internal has already freed temp_word->word
 		     for us because of the way it prints error messages. */
@@ -10755,10 +11531,7 @@ add_quoted_character:
 	  SADD_MBCHAR (temp, string, sindex, string_size);
 
 add_character:
-	  RESIZE_MALLOCED_BUFFER (istring, istring_index, 1, istring_size,
-				  DEFAULT_ARRAY_SIZE);
-	  istring[istring_index++] = c;
-	  istring[istring_index] = '\0';
+	  STRBUF_ADDC (&ibuf, c);
 
 	  /* Next character. */
 	  sindex++;
@@ -10786,6 +11559,8 @@ finished_with_string:
      saw a quoted null from a ${} expansion and add one back if we
      need to. */
 
+  istring = strbuf_release (&ibuf);
+
   /* If we expand to nothing and there were no single or double quotes
      in the word, we throw it away.  Otherwise, we return a NULL word.
      The single exception is for $@ surrounded by double quotes when
@@ -10796,6 +11571,7 @@ finished_with_string:
     {
       if (quoted_dollar_at == 0 && (had_quoted_null || quoted_state == PARTIALLY_QUOTED))
 	{
+	  istring = (char *)xrealloc (istring, 2);
 	  istring[0] = CTLNUL;
 	  istring[1] = '\0';
 	  tword = alloc_word_desc ();
@@ -10822,6 +11598,8 @@ finished_with_string:
       tword->word = istring;
       if (had_quoted_null && QUOTED_NULL (istring))
 	tword->flags |= W_HASQUOTEDNULL;
+      if (NO_CTLCHARS (istring))
+	tword->flags |= W_NOCTLCHARS;
       istring = 0;		/* avoid later free() */
       if (word->flags & W_ASSIGNMENT)
 	tword->flags |= W_ASSIGNMENT;	/* XXX */
@@ -10929,6 +11707,9 @@ finished_with_string:
 	    free (istring);
 	  istring = 0;			/* avoid later free() */
 set_word_flags:
+	  /* Let quote removal skip words with nothing to remove */
+	  if (NO_CTLCHARS (tword->word))
+	    tword->flags |= W_NOCTLCHARS;
 	  if ((quoted & (Q_DOUBLE_QUOTES|Q_HERE_DOCUMENT)) || (quoted_state == WHOLLY_QUOTED))
 	    tword->flags |= W_QUOTED;
 	  if (word->flags & W_ASSIGNMENT)
@@ -11079,6 +11860,7 @@ setifs (v)
 {
   char *t;
   unsigned char uc;
+  int i;
 
   ifs_var = v;
   ifs_value = (v && value_cell (v)) ? value_cell (v) : " \t\n";
@@ -11089,10 +11871,28 @@ setifs (v)
   /* Should really merge ifs_cmap with sh_syntaxtab.  XXX - doesn't yet
      handle multibyte chars in IFS */
   memset (ifs_cmap, '\0', sizeof (ifs_cmap));
+  memset (ifs_split_class, IFS_SPLIT_WORD, sizeof (ifs_split_class));
+  ifs_split_ok = 1;
   for (t = ifs_value ; t && *t; t++)
     {
       uc = *t;
       ifs_cmap[uc] = 1;
+      /* In a UTF-8 locale, ASCII bytes are never part of another character */
+      if (uc > 127 || uc == CTLESC || uc == CTLNUL)
+	ifs_split_ok = 0;
+      else
+	ifs_split_class[uc] = ISSPACE (uc) ? IFS_SPLIT_WHITE : IFS_SPLIT_DELIM;
+    }
+
+  if (ifs_split_ok)
+    {
+      i = 0;
+      for (uc = 1; uc <= 127; uc++)
+	if (ifs_split_class[uc] != IFS_SPLIT_WORD)
+	  ifs_split_stop[i++] = uc;
+      ifs_split_stop[i++] = CTLESC;
+      ifs_split_stop[i++] = CTLNUL;
+      ifs_split_stop[i] = '\0';
     }
 
 #if defined (HANDLE_MULTIBYTE)
@@ -11408,7 +12208,7 @@ glob_expand_word_list (tlist, eflags)
 	    }
 
 	  /* Dequote the current word in case we have to use it. */
-	  if (glob_array[0] == NULL)
+	  if (glob_array[0] == NULL && (tlist->word->flags & W_NOCTLCHARS) == 0)
 	    {
 	      temp_string = dequote_string (tlist->word->word);
 	      free (tlist->word->word);
@@ -11447,10 +12247,13 @@ glob_expand_word_list (tlist, eflags)
 	}
       else
 	{
-	  /* Dequote the string. */
-	  temp_string = dequote_string (tlist->word->word);
-	  free (tlist->word->word);
-	  tlist->word->word = temp_string;
+	  /* Dequote the string, unless there is nothing to remove. */
+	  if ((tlist->word->flags & W_NOCTLCHARS) == 0)
+	    {
+	      temp_string = dequote_string (tlist->word->word);
+	      free (tlist->word->word);
+	      tlist->word->word = temp_string;
+	    }
 	  PREPEND_LIST (tlist, output_list);
 	}
 
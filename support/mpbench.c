@@ -0,0 +1,269 @@
+/*
+ * mpbench - microbenchmark for the BashMath scanner, parser and evaluator
+ *
+ * Built from the mp_*.c sources alone ('make mpbench'), without the rest of
+ * Bash. Each expression of a corpus is scanned and evaluated repeatedly,
+ * and the time per token scanned, the time per parse node evaluated and
+ * the allocations per expression are written to stdout as JSON, one object
+ * per case, so that results can be compared between releases.
+ *
+ * usage: mpbench [-t milliseconds] [corpus]
+ *
+ *  -t: The minimum time each measurement runs for (default 200)
+ *  corpus: A file of cases, each line a case name followed by an
+ *          expression. Blank lines and lines starting with '#' are skipped.
+ *          The built-in corpus is used if no file is given.
+ */
+#include <time.h>
+
+#include "math_parser.h"
+
+/* The counting allocators below call the real ones */
+#undef malloc
+#undef realloc
+#undef strdup
+
+/* The number of terms in the generated polynomial */
+#define POLY_TERMS 38
+/* How deeply the generated parentheses nest */
+#define PAREN_DEPTH 110
+/* The number of repetitions of the generated bitwise expression */
+#define BITWISE_REPS 20
+
+typedef struct {
+    char* name;
+    char* expression;
+} Case;
+
+/* The number of parse nodes entered, see PARSE_ENTRY */
+unsigned long stat_nodes;
+/* The number of allocations made by BashMath */
+static unsigned long stat_allocs;
+
+void* stat_malloc(size_t n)
+{
+    stat_allocs++;
+    return malloc(n);
+}
+
+void* stat_realloc(void* p, size_t n)
+{
+    stat_allocs++;
+    return realloc(p, n);
+}
+
+char* stat_strdup(const char* s)
+{
+    stat_allocs++;
+    return strdup(s);
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Scans and evaluates an expression once, without printing the result.
+ *
+ * returns: 1 if the expression was evaluated without error, 0 otherwise
+ */
+static int run_expression(const char* expression)
+{
+    if (scan_expression(expression) < 0)
+        return 0;
+    Value value = evaluate_expression();
+    free_value(&value);
+    return !ctx->error_encountered
+        && ctx->token_stream_idx == ctx->tokens_in_stream - 1;
+}
+
+/*
+ * Repeats scanning (or evaluating) the current expression, doubling the
+ * number of iterations until a measurement takes at least min_ns.
+ *
+ * expression: The expression to scan, or NULL to evaluate the token
+ *             stream already scanned
+ *     min_ns: The minimum duration of the measurement
+ *     allocs: Set to the allocations made per iteration
+ *
+ * returns: The nanoseconds taken per iteration
+ */
+static double measure(const char* expression, double min_ns, double* allocs)
+{
+    double elapsed = 0;
+    long iterations = 1;
+
+    for (;;) {
+        stat_allocs = 0;
+        double start = now_ns();
+        for (long i = 0; i < iterations; i++) {
+            if (expression != NULL)
+                scan_expression(expression);
+            else {
+                Value value = evaluate_expression();
+                free_value(&value);
+            }
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= min_ns)
+            break;
+        iterations *= 2;
+    }
+    *allocs = (double)stat_allocs / iterations;
+    return elapsed / iterations;
+}
+
+static void print_json_string(const char* s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            putchar('\\');
+        if ((unsigned char)*s >= ' ')
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+/*
+ * Benchmarks one case, printing its results as a JSON object.
+ */
+static void run_case(const Case* c, double min_ns, int first)
+{
+    printf("%s\n    {\"name\": ", first ? "" : ",");
+    print_json_string(c->name);
+    printf(", \"expression_bytes\": %zu", strlen(c->expression));
+
+    /* One untimed run establishes the token and node counts */
+    int tokens = scan_expression(c->expression);
+    stat_nodes = 0;
+    if (tokens < 0 || !run_expression(c->expression)) {
+        printf(", \"error\": true}");
+        return;
+    }
+    unsigned long nodes = stat_nodes;
+
+    double scan_allocs, eval_allocs;
+    double scan_ns = measure(c->expression, min_ns, &scan_allocs);
+    double eval_ns = measure(NULL, min_ns, &eval_allocs);
+
+    printf(", \"tokens\": %d, \"nodes\": %lu", tokens, nodes);
+    printf(", \"scan_ns_per_token\": %.2f", scan_ns / tokens);
+    printf(", \"eval_ns_per_node\": %.2f", eval_ns / nodes);
+    printf(", \"ns_per_expression\": %.1f", scan_ns + eval_ns);
+    printf(", \"allocs_per_expression\": %.2f}", scan_allocs + eval_allocs);
+}
+
+/*
+ * Appends formatted text to a generated expression
+ */
+static void append(char* expression, const char* fmt, int a, int b)
+{
+    size_t len = strlen(expression);
+    snprintf(expression + len, BUFF_SZ - len, fmt, a, b);
+}
+
+/*
+ * Builds the built-in corpus: long polynomials, deep parentheses, bitwise
+ * chains, large sums and vector arithmetic.
+ *
+ * returns: The number of cases
+ */
+static int builtin_corpus(Case* cases)
+{
+    int n = 0;
+    char* poly = calloc(BUFF_SZ, 1);
+    char* parens = calloc(BUFF_SZ, 1);
+    char* bitwise = calloc(BUFF_SZ, 1);
+
+    strcpy(poly, "1");
+    for (int i = 1; i <= POLY_TERMS; i++)
+        append(poly, i % 2 ? " + %d*x**%d" : " - %d*y**%d", i, i % 5 + 1);
+    cases[n++] = (Case){ "polynomial", poly };
+
+    for (int i = 0; i < PAREN_DEPTH; i++)
+        strcat(parens, "(");
+    strcat(parens, "x+1");
+    for (int i = 0; i < PAREN_DEPTH; i++)
+        strcat(parens, ")");
+    cases[n++] = (Case){ "deep_parens", parens };
+
+    strcpy(bitwise, "0xff");
+    for (int i = 0; i < BITWISE_REPS; i++)
+        append(bitwise, " ^ 0b1010 | 017 & %d << %d >> 1", 255 - i, i % 7);
+    cases[n++] = (Case){ "bitwise", bitwise };
+
+    cases[n++] = (Case){ "assignment", "z = x * y + 1" };
+    cases[n++] = (Case){ "sum_loop", "sum i over 1...1000 in i*i + 3*i + 1" };
+    cases[n++] = (Case){ "sum_range", "sum [1...1000000]" };
+    cases[n++] = (Case){ "vector_arith",
+        "sum [1...10000] * 3 + [1...10000] % 7" };
+    return n;
+}
+
+/*
+ * Reads cases from a corpus file.
+ *
+ * returns: The number of cases, or -1 if the file could not be read
+ */
+static int file_corpus(const char* path, Case* cases, int max_cases)
+{
+    char line[BUFF_SZ + MAX_IDENT_LENGTH + 2];
+    FILE* f = fopen(path, "r");
+    int n = 0;
+
+    if (f == NULL)
+        return -1;
+    while (n < max_cases && fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        char* expression = line + strcspn(line, " \t");
+        if (line[0] == '#' || *expression == '\0')
+            continue;
+        *expression++ = '\0';
+        expression += strspn(expression, " \t");
+        cases[n++] = (Case){ strdup(line), strdup(expression) };
+    }
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    Case cases[MAX_TOKENS];
+    double min_ns = 200 * 1e6;
+    const char* corpus = NULL;
+    int count;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            min_ns = atof(argv[++i]) * 1e6;
+        else if (argv[i][0] != '-' && corpus == NULL)
+            corpus = argv[i];
+        else {
+            fprintf(stderr, "usage: %s [-t milliseconds] [corpus]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    count = corpus ? file_corpus(corpus, cases, MAX_TOKENS)
+        : builtin_corpus(cases);
+    if (count < 0) {
+        perror(corpus);
+        return 1;
+    }
+
+    use_context(make_context());
+    /* Identifiers read by the corpus */
+    run_expression("x = 3");
+    run_expression("y = 5");
+
+    printf("{\"benchmark\": \"bashmath\", \"min_ms\": %.0f, \"cases\": [",
+        min_ns / 1e6);
+    for (int i = 0; i < count; i++)
+        run_case(&cases[i], min_ns, i == 0);
+    printf("\n]}\n");
+    return 0;
+}
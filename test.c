@@ -376,7 +376,7 @@ patcomp (string, pat, op)
 {
   int m;
 
-  m = strmatch (pat, string, FNMATCH_EXTFLAG|FNMATCH_IGNCASE);
+  m = strmatch_cached (pat, string, FNMATCH_EXTFLAG|FNMATCH_IGNCASE);
   return ((op == EQ) ? (m == 0) : (m != 0));
 }
 
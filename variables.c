@@ -165,6 +165,22 @@ char **export_env = (char **)NULL;
 static int export_env_index;
 static int export_env_size;
 
+/* The index in EXPORT_ENV of each name's entry, kept in step with
+   EXPORT_ENV so that single entries can be replaced or removed without
+   searching it.  Each bucket's data is an int. */
+static HASH_TABLE *export_env_slots;
+
+/* The names of variables whose entries in EXPORT_ENV may be out of date.
+   maybe_make_export_env rewrites just these entries unless the whole
+   array needs making. */
+static char **export_env_dirty;
+static int export_dirty_len;
+static int export_dirty_size;
+
+/* Past this many changed names, rebuilding EXPORT_ENV is cheaper than
+   updating it entry by entry */
+#define EXPORT_DIRTY_MAX()	(export_env_index / 4 + 16)
+
 #if defined (READLINE)
 static int winsize_assignment;		/* currently assigning to LINES or COLUMNS */
 #endif
@@ -175,6 +191,38 @@ static SHELL_VAR nameref_maxloop_value;
 static HASH_TABLE *last_table_searched;	/* hash_lookup sets this */
 static VAR_CONTEXT *last_context_searched;
 
+/* A direct-mapped cache from a variable name's hash to the variable that
+   a lookup starting at shell_variables last found, so that references to
+   globals from deep in a function call stack need not search every
+   context.  An entry is valid only while its generation is current; any
+   variable being bound into or removed from a context, or any context
+   being pushed or popped, starts a new generation. */
+#define VAR_CACHE_SIZE		256	/* must be power of two */
+
+struct var_cache_entry {
+  unsigned int generation;
+  unsigned int khash;
+  SHELL_VAR *var;
+  HASH_TABLE *table;		/* the table VAR was found in */
+};
+
+static struct var_cache_entry var_cache[VAR_CACHE_SIZE];
+static unsigned int var_cache_generation = 1;
+static VAR_CONTEXT *var_cache_head;	/* shell_variables when filled */
+
+/* Lookup cache statistics, see var_cache_pstats */
+static unsigned long var_cache_hits;
+static unsigned long var_cache_misses;
+
+#define INVALIDATE_VAR_CACHE() \
+  do { \
+    if (++var_cache_generation == 0) \
+      { \
+	memset (var_cache, 0, sizeof (var_cache)); \
+	var_cache_generation = 1; \
+      } \
+  } while (0)
+
 /* Some forward declarations. */
 static void create_variable_tables PARAMS((void));
 
@@ -262,6 +310,8 @@ static SHELL_VAR *bind_invalid_envvar PARAMS((const char *, char *, int));
 static int var_sametype PARAMS((SHELL_VAR *, SHELL_VAR *));
 
 static SHELL_VAR *hash_lookup PARAMS((const char *, HASH_TABLE *));
+static SHELL_VAR *hash_lookup_hashed PARAMS((const char *, unsigned int, HASH_TABLE *));
+static SHELL_VAR *var_lookup_cached PARAMS((const char *, unsigned int));
 static SHELL_VAR *new_shell_variable PARAMS((const char *));
 static SHELL_VAR *make_new_variable PARAMS((const char *, HASH_TABLE *));
 static SHELL_VAR *bind_variable_internal PARAMS((const char *, char *, HASH_TABLE *, int, int));
@@ -306,6 +356,12 @@ static inline char *mk_env_string PARAMS((const char *, const char *, int));
 static char **make_env_array_from_var_list PARAMS((SHELL_VAR **));
 static char **make_var_export_array PARAMS((VAR_CONTEXT *));
 static char **make_func_export_array PARAMS((void));
+static BUCKET_CONTENTS *export_slot_search PARAMS((const char *, int));
+static void export_slot_add PARAMS((const char *, int));
+static void export_slot_delete PARAMS((BUCKET_CONTENTS *));
+static void make_export_slots PARAMS((void));
+static SHELL_VAR *find_export_candidate PARAMS((const char *));
+static void update_dirty_export_vars PARAMS((void));
 static void add_temp_array_to_env PARAMS((char **, int, int));
 
 static int n_shell_variables PARAMS((void));
@@ -1718,7 +1774,7 @@ static SHELL_VAR *
 build_hashcmd (self)
      SHELL_VAR *self;
 {
-  HASH_TABLE *h;
+  ASSOC *h;
   int i;
   char *k, *v;
   BUCKET_CONTENTS *item;
@@ -1733,7 +1789,7 @@ build_hashcmd (self)
       return self;
     }
 
-  h = assoc_create (hashed_filenames->nbuckets);
+  h = assoc_create (HASH_ENTRIES (hashed_filenames));
   for (i = 0; i < hashed_filenames->nbuckets; i++)
     {
       for (item = hash_items (i, hashed_filenames); item; item = item->next)
@@ -1794,7 +1850,7 @@ static SHELL_VAR *
 build_aliasvar (self)
      SHELL_VAR *self;
 {
-  HASH_TABLE *h;
+  ASSOC *h;
   int i;
   char *k, *v;
   BUCKET_CONTENTS *item;
@@ -1809,7 +1865,7 @@ build_aliasvar (self)
       return self;
     }
 
-  h = assoc_create (aliases->nbuckets);
+  h = assoc_create (HASH_ENTRIES (aliases));
   for (i = 0; i < aliases->nbuckets; i++)
     {
       for (item = hash_items (i, aliases); item; item = item->next)
@@ -1991,10 +2047,21 @@ static SHELL_VAR *
 hash_lookup (name, hashed_vars)
      const char *name;
      HASH_TABLE *hashed_vars;
+{
+  return (hash_lookup_hashed (name, hash_string (name), hashed_vars));
+}
+
+/* Like hash_lookup, but HV is NAME's hash.  Functions walking the chain of
+   variable contexts hash NAME once and use this at each level. */
+static SHELL_VAR *
+hash_lookup_hashed (name, hv, hashed_vars)
+     const char *name;
+     unsigned int hv;
+     HASH_TABLE *hashed_vars;
 {
   BUCKET_CONTENTS *bucket;
 
-  bucket = hash_search (name, hashed_vars, 0);
+  bucket = hash_search_hashed (name, hv, hashed_vars, 0);
   /* If we find the name in HASHED_VARS, set LAST_TABLE_SEARCHED to that
      table. */
   if (bucket)
@@ -2002,6 +2069,50 @@ hash_lookup (name, hashed_vars)
   return (bucket ? (SHELL_VAR *)bucket->data : (SHELL_VAR *)NULL);
 }
 
+/* Look up NAME, which hashes to HV, in shell_variables, using the lookup
+   cache.  Returns the first variable found, even if it is invisible. */
+static SHELL_VAR *
+var_lookup_cached (name, hv)
+     const char *name;
+     unsigned int hv;
+{
+  struct var_cache_entry *ce;
+  VAR_CONTEXT *vc;
+  SHELL_VAR *v;
+
+  /* Code outside this file may pop a builtin scope behind our back */
+  if (var_cache_head != shell_variables)
+    {
+      INVALIDATE_VAR_CACHE ();
+      var_cache_head = shell_variables;
+    }
+
+  ce = &var_cache[hv & (VAR_CACHE_SIZE - 1)];
+  if (ce->generation == var_cache_generation && ce->khash == hv &&
+	STREQ (ce->var->name, name))
+    {
+      var_cache_hits++;
+      last_table_searched = ce->table;
+      return (ce->var);
+    }
+
+  var_cache_misses++;
+  v = (SHELL_VAR *)NULL;
+  for (vc = shell_variables; vc; vc = vc->down)
+    if (v = hash_lookup_hashed (name, hv, vc->table))
+      break;
+
+  /* Only hits are cached; a miss binds nothing for a later lookup to find */
+  if (v)
+    {
+      ce->generation = var_cache_generation;
+      ce->khash = hv;
+      ce->var = v;
+      ce->table = last_table_searched;
+    }
+  return v;
+}
+
 SHELL_VAR *
 var_lookup (name, vcontext)
      const char *name;
@@ -2009,15 +2120,33 @@ var_lookup (name, vcontext)
 {
   VAR_CONTEXT *vc;
   SHELL_VAR *v;
+  unsigned int hv;
 
   v = (SHELL_VAR *)NULL;
+  hv = hash_string (name);
+  if (vcontext && vcontext == shell_variables)
+    return (var_lookup_cached (name, hv));
+
   for (vc = vcontext; vc; vc = vc->down)
-    if (v = hash_lookup (name, vc->table))
+    if (v = hash_lookup_hashed (name, hv, vc->table))
       break;
 
   return v;
 }
 
+/* Print the lookup cache's hit rate to stderr.  The varcache loadable
+   builtin in examples/loadables calls this. */
+void
+var_cache_pstats ()
+{
+  unsigned long total;
+
+  total = var_cache_hits + var_cache_misses;
+  fprintf (stderr, "variable lookup cache: %lu hits, %lu misses (%lu%% hit rate), generation %u\n",
+	   var_cache_hits, var_cache_misses,
+	   total ? var_cache_hits * 100 / total : 0UL, var_cache_generation);
+}
+
 /* Look up the variable entry named NAME.  If SEARCH_TEMPENV is non-zero,
    then also search the temporarily built list of exported variables.
    The lookup order is:
@@ -2033,6 +2162,7 @@ find_variable_internal (name, flags)
   SHELL_VAR *var;
   int search_tempenv, force_tempenv;
   VAR_CONTEXT *vc;
+  unsigned int hv;
 
   var = (SHELL_VAR *)NULL;
 
@@ -2045,25 +2175,26 @@ find_variable_internal (name, flags)
      "subshell environment". */
   search_tempenv = force_tempenv || (expanding_redir == 0 && subshell_environment);
 
+  /* NAME is hashed once for the temporary env and every variable context */
+  hv = hash_string (name);
+
   if (search_tempenv && temporary_env)		
-    var = hash_lookup (name, temporary_env);
+    var = hash_lookup_hashed (name, hv, temporary_env);
 
-  if (var == 0)
+  if (var == 0 && shell_variables)
+    var = var_lookup_cached (name, hv);
+
+  if (var && (flags & FV_SKIPINVISIBLE) && invisible_p (var))
     {
-      if ((flags & FV_SKIPINVISIBLE) == 0)
-	var = var_lookup (name, shell_variables);
-      else
+      /* essentially var_lookup expanded inline so we can skip variables
+	 with att_invisible */
+      for (var = 0, vc = shell_variables; vc; vc = vc->down)
 	{
-	  /* essentially var_lookup expanded inline so we can check for
-	     att_invisible */
-	  for (vc = shell_variables; vc; vc = vc->down)
-	    {
-	      var = hash_lookup (name, vc->table);
-	      if (var && invisible_p (var))
-		var = 0;
-	      if (var)
-		break;
-	    }
+	  var = hash_lookup_hashed (name, hv, vc->table);
+	  if (var && invisible_p (var))
+	    var = 0;
+	  if (var)
+	    break;
 	}
     }
 
@@ -2805,6 +2936,7 @@ make_new_variable (name, table)
 
   elt = hash_insert (savestring (name), table, HASH_NOSRCH);
   elt->data = (PTR_T)entry;
+  INVALIDATE_VAR_CACHE ();
 
   return entry;
 }
@@ -2871,7 +3003,7 @@ make_new_assoc_variable (name)
      char *name;
 {
   SHELL_VAR *entry;
-  HASH_TABLE *hash;
+  ASSOC *hash;
 
   entry = make_new_variable (name, global_variables->table);
   hash = assoc_create (ASSOC_HASH_BUCKETS);
@@ -2887,7 +3019,7 @@ make_local_assoc_variable (name, flags)
      int flags;
 {
   SHELL_VAR *var;
-  HASH_TABLE *hash;
+  ASSOC *hash;
   int array_ok;
 
   array_ok = flags & MKLOC_ARRAYOK;
@@ -3198,7 +3330,7 @@ assign_value:
 	    VSETATTR (entry, att_exported);
 
 	  if (exported_p (entry))
-	    array_needs_making = 1;
+	    invalidate_export_var (entry->name);
 
 	  return (entry);
 	}
@@ -3240,7 +3372,7 @@ assign_value:
     VSETATTR (entry, att_exported);
 
   if (exported_p (entry))
-    array_needs_making = 1;
+    invalidate_export_var (entry->name);
 
   return (entry);
 }
@@ -3257,6 +3389,7 @@ bind_variable (name, value, flags)
 {
   SHELL_VAR *v, *nv;
   VAR_CONTEXT *vc, *nvc;
+  unsigned int hv;
 
   if (shell_variables == 0)
     create_variable_tables ();
@@ -3270,11 +3403,12 @@ bind_variable (name, value, flags)
     bind_tempenv_variable (name, value);
 
   /* XXX -- handle local variables here. */
+  hv = hash_string (name);
   for (vc = shell_variables; vc; vc = vc->down)
     {
       if (vc_isfuncenv (vc) || vc_isbltnenv (vc))
 	{
-	  v = hash_lookup (name, vc->table);
+	  v = hash_lookup_hashed (name, hv, vc->table);
 	  nvc = vc;
 	  if (v && nameref_p (v))
 	    {
@@ -3777,11 +3911,13 @@ dispose_variable (var)
 
   FREE_EXPORTSTR (var);
 
-  free (var->name);
-
-  if (exported_p (var))
+  /* Exported functions are not tracked by name in EXPORT_ENV */
+  if (exported_p (var) && function_p (var))
     array_needs_making = 1;
+  else if (exported_p (var))
+    invalidate_export_var (var->name);
 
+  free (var->name);
   free (var);
 }
 
@@ -3917,6 +4053,7 @@ delete_var (name, vc)
 
   if (elt == 0)
     return (-1);
+  INVALIDATE_VAR_CACHE ();
 
   old_var = (SHELL_VAR *)elt->data;
   free (elt->key);
@@ -3946,11 +4083,12 @@ makunbound (name, vc)
 
   if (elt == 0)
     return (-1);
+  INVALIDATE_VAR_CACHE ();
 
   old_var = (SHELL_VAR *)elt->data;
 
   if (old_var && exported_p (old_var))
-    array_needs_making++;
+    invalidate_export_var (old_var->name);
 
   /* If we're unsetting a local variable and we're still executing inside
      the function, just mark the variable as invisible.  The function
@@ -4041,6 +4179,7 @@ void
 delete_all_variables (hashed_vars)
      HASH_TABLE *hashed_vars;
 {
+  INVALIDATE_VAR_CACHE ();
   hash_flush (hashed_vars, free_variable_hash_data);
 }
 
@@ -4644,6 +4783,7 @@ dispose_temporary_env (pushf)
   disposer = temporary_env;
   temporary_env = (HASH_TABLE *)NULL;
 
+  INVALIDATE_VAR_CACHE ();
   hash_flush (disposer, pushf);
   hash_dispose (disposer);
 
@@ -4931,6 +5071,7 @@ add_or_supercede_exported_var (assign, do_alloc)
 {
   register int i;
   int equal_offset;
+  BUCKET_CONTENTS *item;
 
   equal_offset = assignment (assign, 0);
   if (equal_offset == 0)
@@ -4942,6 +5083,22 @@ add_or_supercede_exported_var (assign, do_alloc)
   if (assign[equal_offset + 1] == '(' &&
      strncmp (assign + equal_offset + 2, ") {", 3) == 0)		/* } */
     equal_offset += 4;
+  else if (export_env_slots)
+    {
+      /* Plain NAME=value assignments can find their entry by name */
+      if (item = export_slot_search (assign, 0))
+	{
+	  i = *(int *)item->data;
+	  free (export_env[i]);
+	  export_env[i] = do_alloc ? savestring (assign) : assign;
+	}
+      else
+	{
+	  add_to_export_env (assign, do_alloc);
+	  export_slot_add (export_env[export_env_index - 1], export_env_index - 1);
+	}
+      return (export_env);
+    }
 
   for (i = 0; i < export_env_index; i++)
     {
@@ -4953,6 +5110,8 @@ add_or_supercede_exported_var (assign, do_alloc)
 	}
     }
   add_to_export_env (assign, do_alloc);
+  if (export_env_slots)
+    export_slot_add (export_env[export_env_index - 1], export_env_index - 1);
   return (export_env);
 }
 
@@ -4977,10 +5136,190 @@ add_temp_array_to_env (temp_array, do_alloc, do_supercede)
   free (temp_array);
 }
 
+/* Return the bucket of EXPORT_ENV_SLOTS for the name in ENVSTR, which is
+   either a NAME=value string or a bare NAME, creating it if CREATE is
+   non-zero. */
+static BUCKET_CONTENTS *
+export_slot_search (envstr, create)
+     const char *envstr;
+     int create;
+{
+  BUCKET_CONTENTS *item;
+  char *eq, *name;
+
+  eq = strchr (envstr, '=');
+  name = eq ? substring (envstr, 0, eq - envstr) : (char *)envstr;
+
+  item = hash_search (name, export_env_slots, 0);
+  if (item == 0 && create)
+    {
+      item = hash_insert (eq ? name : savestring (name), export_env_slots, HASH_NOSRCH);
+      item->data = xmalloc (sizeof (int));
+      *(int *)item->data = -1;
+      return item;
+    }
+
+  if (eq)
+    free (name);
+  return item;
+}
+
+/* Record that EXPORT_ENV[IND] is ENVSTR's entry, unless an earlier entry
+   for the same name was already recorded. */
+static void
+export_slot_add (envstr, ind)
+     const char *envstr;
+     int ind;
+{
+  BUCKET_CONTENTS *item;
+
+  item = export_slot_search (envstr, 1);
+  if (*(int *)item->data < 0)
+    *(int *)item->data = ind;
+}
+
+/* Remove ITEM's entry from EXPORT_ENV, moving the last entry into the
+   hole so the array stays contiguous, and forget ITEM. */
+static void
+export_slot_delete (item)
+     BUCKET_CONTENTS *item;
+{
+  BUCKET_CONTENTS *moved;
+  int i, last;
+
+  i = *(int *)item->data;
+  last = --export_env_index;
+
+  free (export_env[i]);
+  if (i != last)
+    {
+      export_env[i] = export_env[last];
+      moved = export_slot_search (export_env[i], 0);
+      if (moved && *(int *)moved->data == last)
+	*(int *)moved->data = i;
+    }
+  export_env[last] = (char *)NULL;
+
+  item = hash_remove (item->key, export_env_slots, 0);
+  free (item->key);
+  free (item->data);
+  free (item);
+}
+
+/* Index every entry of a freshly-made EXPORT_ENV by name. */
+static void
+make_export_slots ()
+{
+  register int i;
+
+  if (export_env_slots == 0)
+    export_env_slots = hash_create (VARIABLES_HASH_BUCKETS);
+  else
+    hash_flush (export_env_slots, (sh_free_func_t *)NULL);
+
+  for (i = 0; i < export_env_index; i++)
+    export_slot_add (export_env[i], i);
+}
+
+/* Note that the entry in EXPORT_ENV for the variable NAME may have
+   changed, because NAME was assigned, unset, exported or unexported.  The
+   next call to maybe_make_export_env rewrites just that entry. */
+void
+invalidate_export_var (name)
+     const char *name;
+{
+  /* The whole array is remade anyway */
+  if (array_needs_making || export_env_slots == 0)
+    return;
+
+  if (export_dirty_len && STREQ (export_env_dirty[export_dirty_len - 1], name))
+    return;
+
+  if (export_dirty_len + 1 >= export_dirty_size)
+    {
+      export_dirty_size += 16;
+      export_env_dirty = strvec_resize (export_env_dirty, export_dirty_size);
+    }
+  export_env_dirty[export_dirty_len++] = savestring (name);
+  export_env_dirty[export_dirty_len] = (char *)NULL;
+}
+
+/* Return the variable that supplies NAME's entry in the environment, in
+   the same order that maybe_make_export_env searches: invalid_env,
+   temporary_env, then shell_variables.  This doesn't use hash_lookup,
+   since callers may depend on last_table_searched. */
+static SHELL_VAR *
+find_export_candidate (name)
+     const char *name;
+{
+  BUCKET_CONTENTS *item;
+  VAR_CONTEXT *vc;
+  SHELL_VAR *v;
+
+#define CANDIDATE_IN(table) \
+  ((item = hash_search (name, (table), 0)) && \
+   export_environment_candidate (v = (SHELL_VAR *)item->data))
+
+  if (invalid_env && CANDIDATE_IN (invalid_env))
+    return v;
+  if (temporary_env && CANDIDATE_IN (temporary_env))
+    return v;
+  for (vc = shell_variables; vc; vc = vc->down)
+    if (CANDIDATE_IN (vc->table))
+      return v;
+
+#undef CANDIDATE_IN
+  return ((SHELL_VAR *)NULL);
+}
+
+/* Bring the entries of EXPORT_ENV for each name on EXPORT_ENV_DIRTY up to
+   date, adding, replacing, or removing each one. */
+static void
+update_dirty_export_vars ()
+{
+  register int i;
+  SHELL_VAR *vars[2];
+  BUCKET_CONTENTS *item;
+  char **list, *envstr;
+
+  for (i = 0; i < export_dirty_len; i++)
+    {
+      vars[0] = find_export_candidate (export_env_dirty[i]);
+      vars[1] = (SHELL_VAR *)NULL;
+
+      envstr = (char *)NULL;
+      if (vars[0])
+	{
+	  list = make_env_array_from_var_list (vars);
+	  envstr = list[0];
+	  free (list);
+	}
+
+      item = export_slot_search (export_env_dirty[i], 0);
+      if (envstr && item)
+	{
+	  free (export_env[*(int *)item->data]);
+	  export_env[*(int *)item->data] = envstr;
+	}
+      else if (envstr)
+	{
+	  add_to_export_env (envstr, 0);
+	  export_slot_add (envstr, export_env_index - 1);
+	}
+      else if (item)
+	export_slot_delete (item);
+
+      free (export_env_dirty[i]);
+    }
+  export_env_dirty[export_dirty_len = 0] = (char *)NULL;
+}
+
 /* Make the environment array for the command about to be executed, if the
-   array needs making.  Otherwise, do nothing.  If a shell action could
-   change the array that commands receive for their environment, then the
-   code should `array_needs_making++'.
+   array needs making.  Otherwise, update the entries for any variables
+   passed to invalidate_export_var.  If a shell action could change the
+   array that commands receive for their environment, then the code should
+   `array_needs_making++', or call invalidate_export_var if the change is
+   confined to a single variable.
 
    The order to add to the array is:
    	temporary_env
@@ -5027,7 +5366,12 @@ maybe_make_export_env ()
   int new_size;
   VAR_CONTEXT *tcxt, *icxt;
 
-  if (array_needs_making)
+  if (array_needs_making == 0 && export_dirty_len > EXPORT_DIRTY_MAX ())
+    array_needs_making = 1;
+
+  if (array_needs_making == 0 && export_dirty_len)
+    update_dirty_export_vars ();
+  else if (array_needs_making)
     {
       if (export_env)
 	strvec_flush (export_env);
@@ -5087,6 +5431,13 @@ maybe_make_export_env ()
       if (temp_array)
 	add_temp_array_to_env (temp_array, 0, 0);
 
+      make_export_slots ();
+      if (export_dirty_len)
+	{
+	  strvec_flush (export_env_dirty);
+	  export_env_dirty[export_dirty_len = 0] = (char *)NULL;
+	}
+
       array_needs_making = 0;
     }
 }
@@ -5209,6 +5560,7 @@ push_var_context (name, flags, tempvars)
     }
   vc->down = shell_variables;
   shell_variables->up = vc;
+  INVALIDATE_VAR_CACHE ();
 
   return (shell_variables = vc);
 }
@@ -5336,6 +5688,7 @@ pop_var_context ()
     {
       ret->up = (VAR_CONTEXT *)NULL;
       shell_variables = ret;
+      INVALIDATE_VAR_CACHE ();
       if (vcxt->table)
 	hash_flush (vcxt->table, push_func_var);
       dispose_var_context (vcxt);
@@ -5360,6 +5713,7 @@ delete_all_contexts (vcxt)
 
   delete_all_variables (global_variables->table);
   shell_variables = global_variables;
+  INVALIDATE_VAR_CACHE ();
 }
 
 /* **************************************************************** */
@@ -5431,6 +5785,7 @@ pop_scope (is_special)
     ret->up = (VAR_CONTEXT *)NULL;
 
   shell_variables = ret;
+  INVALIDATE_VAR_CACHE ();
 
   /* Now we can take care of merging variables in VCXT into set of scopes
      whose head is RET (shell_variables). */
@@ -6279,6 +6634,7 @@ set_pipestatus_array (ps, nproc)
   /* Fast case */
   if (array_num_elements (a) == nproc && nproc == 1)
     {
+      array_modified (a);	/* before the elements are changed */
       ae = element_forw (a->head);
       free (element_value (ae));
       set_element_value (ae, itos (ps[0]));
@@ -6286,6 +6642,7 @@ set_pipestatus_array (ps, nproc)
   else if (array_num_elements (a) <= nproc)
     {
       /* modify in array_num_elements members in place, then add */
+      array_modified (a);
       ae = a->head;
       for (i = 0; i < array_num_elements (a); i++)
 	{
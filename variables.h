@@ -70,7 +70,7 @@ union _value {
   intmax_t i;			/* int value */
   COMMAND *f;			/* function */
   ARRAY *a;			/* array */
-  HASH_TABLE *h;		/* associative array */
+  ASSOC *h;			/* associative array */
   double d;			/* floating point number */
 #if defined (HAVE_LONG_DOUBLE)
   long double ld;		/* long double */
@@ -166,7 +166,7 @@ typedef struct _vlist {
 #define value_cell(var)		((var)->value)
 #define function_cell(var)	(COMMAND *)((var)->value)
 #define array_cell(var)		(ARRAY *)((var)->value)
-#define assoc_cell(var)		(HASH_TABLE *)((var)->value)
+#define assoc_cell(var)		(ASSOC *)((var)->value)
 #define nameref_cell(var)	((var)->value)		/* so it can change later */
 
 #define NAMEREF_MAX	8	/* only 8 levels of nameref indirection */
@@ -267,6 +267,7 @@ extern void set_ppid PARAMS((void));
 extern void make_funcname_visible PARAMS((int));
 
 extern SHELL_VAR *var_lookup PARAMS((const char *, VAR_CONTEXT *));
+extern void var_cache_pstats PARAMS((void));
 
 extern SHELL_VAR *find_function PARAMS((const char *));
 extern FUNCTION_DEF *find_function_def PARAMS((const char *));
@@ -376,6 +377,7 @@ extern void sort_variables PARAMS((SHELL_VAR **));
 
 extern int chkexport PARAMS((char *));
 extern void maybe_make_export_env PARAMS((void));
+extern void invalidate_export_var PARAMS((const char *));
 extern void update_export_env_inplace PARAMS((char *, int, char *));
 extern void put_command_name_into_env PARAMS((char *));
 extern void put_gnu_argv_flags_into_env PARAMS((intmax_t, char *));